@@ -0,0 +1,205 @@
+/*
+ * ==========================
+ *   FILE: ./arena.c
+ * ==========================
+ * Purpose: Memory for the things that only last as long as one command.
+ *
+ * Outline: Running a command needs a few short-lived pieces of memory --
+ * the words and argv made by lex_line(), the stages of a pipeline, the
+ * values of a for-loop, the parse tree of a line -- and all of them are
+ * done with at the same moment, when the command is over. ar_alloc()
+ * hands them out one after the other from large chunks (a pointer bump,
+ * no malloc()), and they are never freed one at a time: the code that
+ * runs a command takes an ar_mark() first, and ar_release() afterwards
+ * puts the arena back where the mark was in O(1), whatever was allocated
+ * in between. Commands run inside other commands (a loop body, a $(...))
+ * take their own marks, so the marks nest like the commands do.
+ *
+ * Chunks are never given back to malloc(): a release only moves back to
+ * an earlier one, and the later ones are used again by the next command.
+ * So the arena grows to what the biggest command needs and then stays
+ * that size, however many commands are run.
+ *
+ * With SMSH_MEMSTATS set in the environment, the shell prints how much
+ * memory it used when it exits (see ar_memstats()), to show it stays flat.
+ *
+ * interface:
+ *      ar_alloc(n)             -- n bytes, good until the next release
+ *      ar_strndup(s, len)      -- a '\0'-terminated copy in the arena
+ *      ar_mark(&m)             -- remember the current place
+ *      ar_release(&m)          -- free everything allocated since
+ *      ar_memstats()           -- print memory use at exit
+ */
+
+/* INCLUDES */
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <unistd.h>
+#include    <sys/resource.h>
+#include    "splitline.h"
+#include    "arena.h"
+
+#ifdef __GLIBC__
+#include    <malloc.h>
+#endif
+
+/* CONSTANTS */
+#define AR_CHUNK    (64 * 1024)         // usual size of a chunk
+#define AR_ALIGN    16                  // every allocation is aligned so
+
+/* one chunk of the arena; the chunks form a list, in the order used */
+struct ar_chunk {
+    struct ar_chunk *   ch_next;        // the one after (kept for reuse)
+    size_t              ch_size;        // bytes of space it has
+    char *              ch_data;        // the space
+};
+
+/* FILE-SCOPE VARIABLES */
+static struct ar_chunk * first = NULL;  // the list
+static struct ar_chunk * cur = NULL;    // the chunk in use
+static size_t used = 0;                 // bytes of it in use
+static size_t below = 0;                // bytes in use in the chunks before
+
+static long n_allocs = 0;               // for ar_memstats()
+static long n_releases = 0;
+static int n_chunks = 0;
+static size_t chunk_bytes = 0;
+static size_t peak = 0;
+static pid_t report_pid = 0;
+
+/* INTERNAL FUNCTIONS */
+static void next_chunk(size_t);
+static void report();
+
+/*
+ *  ar_alloc()
+ *  Purpose: Get n bytes of memory that last until the next ar_release()
+ *           of a mark taken before this call
+ *   Return: the memory, aligned for anything; exits if out of memory
+ */
+void * ar_alloc(size_t n)
+{
+    void *p;
+
+    n = (n + AR_ALIGN - 1) & ~(size_t) (AR_ALIGN - 1);
+    if (cur == NULL || cur->ch_size - used < n)
+        next_chunk(n);
+
+    p = cur->ch_data + used;
+    used += n;
+    n_allocs++;
+    if (below + used > peak)
+        peak = below + used;
+    return p;
+}
+
+/*
+ *  ar_strndup()
+ *  Purpose: Copy len chars of s into the arena, with a '\0' after them
+ */
+char * ar_strndup(char * s, size_t len)
+{
+    char *p = ar_alloc(len + 1);
+
+    memcpy(p, s, len);
+    p[len] = '\0';
+    return p;
+}
+
+/*
+ *  next_chunk()
+ *  Purpose: Move on to a chunk with room for n bytes: the next one in the
+ *           list if it is big enough, else a new one put in after cur
+ */
+void next_chunk(size_t n)
+{
+    struct ar_chunk *ch = (cur != NULL ? cur->ch_next : first);
+    size_t size;
+
+    if (ch == NULL || ch->ch_size < n)
+    {
+        size = (n > AR_CHUNK ? n : AR_CHUNK);
+        ch = emalloc(sizeof(struct ar_chunk) + size);
+        ch->ch_data = (char *) ch + ((sizeof(struct ar_chunk) + AR_ALIGN - 1)
+                                     & ~(size_t) (AR_ALIGN - 1));
+        ch->ch_size = size - (ch->ch_data - (char *) ch
+                              - sizeof(struct ar_chunk));
+        if (cur != NULL)
+        {
+            ch->ch_next = cur->ch_next;
+            cur->ch_next = ch;
+        }
+        else
+        {
+            ch->ch_next = first;
+            first = ch;
+        }
+        n_chunks++;
+        chunk_bytes += size;
+    }
+
+    if (cur != NULL)
+        below += used;
+    cur = ch;
+    used = 0;
+}
+
+/*
+ *  ar_mark()
+ *  Purpose: Remember the current place in the arena
+ *    Input: mp, where to keep it
+ */
+void ar_mark(struct ar_mark * mp)
+{
+    mp->am_chunk = cur;
+    mp->am_used = used;
+    mp->am_below = below;
+}
+
+/*
+ *  ar_release()
+ *  Purpose: Go back to a mark: all that was allocated after it is free
+ */
+void ar_release(struct ar_mark * mp)
+{
+    cur = mp->am_chunk;
+    used = mp->am_used;
+    below = mp->am_below;
+    n_releases++;
+}
+
+/*
+ *  ar_memstats()
+ *  Purpose: Have the shell print its memory use to stderr when it exits
+ *     Note: Only the shell itself prints it, not a child forked from it.
+ */
+void ar_memstats()
+{
+    report_pid = getpid();
+    atexit(report);
+}
+
+/*
+ *  report()
+ *  Purpose: Print the memory report (at exit)
+ */
+void report()
+{
+    struct rusage ru;
+
+    if (getpid() != report_pid)
+        return;
+
+    fflush(stdout);
+    getrusage(RUSAGE_SELF, &ru);
+    fprintf(stderr, "smsh: memstats: %ld arena allocs, %ld releases, "
+            "peak %zu bytes in use, %d chunks (%zu bytes)\n",
+            n_allocs, n_releases, peak, n_chunks, chunk_bytes);
+#ifdef __GLIBC__
+    fprintf(stderr, "smsh: memstats: heap in use %zu bytes, max RSS %ld kB\n",
+            mallinfo2().uordblks, ru.ru_maxrss);
+#else
+    fprintf(stderr, "smsh: memstats: max RSS %ld kB\n", ru.ru_maxrss);
+#endif
+}
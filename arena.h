@@ -0,0 +1,26 @@
+/*
+ * ==========================
+ *   FILE: ./arena.h
+ * ==========================
+ * Purpose: Header file for arena.c
+ */
+
+#ifndef	ARENA_H
+#define	ARENA_H
+
+#include    <stddef.h>
+
+/* a place in the arena to go back to (see ar_mark()) */
+struct ar_mark {
+    struct ar_chunk *   am_chunk;       // the chunk in use then
+    size_t              am_used;        // and how much of it was used
+    size_t              am_below;       // bytes used in the chunks before it
+};
+
+void * ar_alloc(size_t n);
+char * ar_strndup(char *s, size_t len);
+void ar_mark(struct ar_mark *mp);
+void ar_release(struct ar_mark *mp);
+void ar_memstats();
+
+#endif
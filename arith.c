@@ -0,0 +1,745 @@
+/*
+ * ==========================
+ *   FILE: ./arith.c
+ * ==========================
+ * Purpose: Arithmetic expansion, $((expression)), done inside the shell.
+ *
+ * Outline: Without arithmetic a script counts with `expr`, which is a fork
+ * and an exec for every step. Here lex_line() (and template.c) hands the
+ * text of a $((...)) to ax_compile(), which turns it into a short list of
+ * instructions for a stack machine, and ax_value() runs that list with
+ * the current values of the variables. The language is that of sh, on
+ * long integers:
+ *      - numbers: decimal, octal (a leading 0) and hex (0x)
+ *      - variables: x or $x, where an unset or empty one is 0; $? and $$
+ *      - unary + - ! ~, then * / %, + -, << >>, < <= > >=, == !=, &, ^, |,
+ *        && and ||, c ? a : b, and = += -= *= /= %= <<= >>= &= ^= |=,
+ *        with the precedence and grouping of C
+ * && and || only evaluate their right side when they need it, and only
+ * the branch of ?: that is taken is evaluated, so x=0 in the other one
+ * does not happen.
+ *
+ * An expression is only compiled once. The compiled form is kept in a hash
+ * table keyed by its text, so a loop that says i=$((i + 1)) parses it on
+ * the first pass and from then on just runs it; a template keeps a pointer
+ * to it and skips even the lookup. Variables are named in the text, not
+ * substituted into it, so the text stays the same whatever their values
+ * are. Entries are never freed: there is one per different expression in
+ * the script.
+ *
+ * Errors are reported with the words 'dash' uses. In a script they are
+ * fatal; interactively, the expansion is left empty and the command goes
+ * on. An expression that nests more than AX_NEST deep is an error too, so
+ * a long "((((..." cannot run the parser out of stack.
+ *
+ * interface:
+ *      ax_scan(cp, end)        -- find the end of a $((...))
+ *      ax_compile(text, len)   -- the compiled form of an expression
+ *      ax_value(ex)            -- evaluate one; the result as text
+ */
+
+/* INCLUDES */
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <ctype.h>
+#include    <unistd.h>
+#include    "smsh.h"
+#include    "splitline.h"
+#include    "varlib.h"
+#include    "arith.h"
+
+/* CONSTANTS */
+#define NBUCKETS    256                 // power of 2: hash chains
+#define AX_STACK    64                  // most values on the stack at once
+#define AX_NEST     200                 // most ( - ! ~ x= ?: inside each other
+#define is_blank(x) ((x)==' ' || (x)=='\t' || (x)=='\n')
+#define is_namech(x) (isalnum((unsigned char) (x)) || (x) == '_')
+#define is_binary(op) ((op) >= AX_MUL && (op) <= AX_BOR)
+
+/* INSTRUCTIONS */
+enum ax_ops {
+    AX_NUM,         // push in_val
+    AX_VAR,         // push the value of the variable in_name
+    AX_STATUS,      // push $?
+    AX_PID,         // push $$
+    AX_SET,         // store the top value in the variable in_name (kept)
+    AX_NEG,         // unary: - ! ~ on the top value
+    AX_NOT,
+    AX_BNOT,
+    AX_MUL,         // binary: pop two, push the result
+    AX_DIV,
+    AX_MOD,
+    AX_ADD,
+    AX_SUB,
+    AX_SHL,
+    AX_SHR,
+    AX_LT,
+    AX_LE,
+    AX_GT,
+    AX_GE,
+    AX_EQ,
+    AX_NE,
+    AX_BAND,
+    AX_BXOR,
+    AX_BOR,
+    AX_ANDJ,        // &&: if the top is 0, keep it and go to in_val
+    AX_ORJ,         // ||: if the top is not 0, make it 1 and go to in_val
+    AX_BOOL,        // make the top value 0 or 1
+    AX_JZ,          // pop, and go to in_val if it was 0
+    AX_JMP };       // go to in_val
+
+struct ax_insn {
+    int     in_op;              // one of ax_ops
+    long    in_val;             // AX_NUM: the number; jumps: where to
+    char *  in_name;            // AX_VAR, AX_SET: the name ('\0'-term)
+    size_t  in_len;             // and its length
+};
+
+/* one compiled expression */
+struct arith {
+    char *          ax_text;        // its text, with the "))" at the end
+    size_t          ax_len;         //  and the length of that
+    struct ax_insn *ax_code;        // the instructions
+    int             ax_ncode;
+    struct arith *  ax_next;        // next in its hash chain
+};
+
+/* an operator, as it is written */
+struct ax_tok {
+    char *  tk_text;
+    int     tk_op;              // its instruction
+    int     tk_prec;            // binary ones: higher binds tighter
+};
+
+/* where a compile is up to */
+struct ax_parse {
+    char *          ap_cp;          // the next char to read
+    char *          ap_end;         // the end of the expression
+    struct arith *  ap_ex;          // the expression being built
+    int             ap_nslots;      // room in its ax_code
+    int             ap_depth;       // values on the stack at this point
+    int             ap_nest;        // parse_*() calls inside each other
+    char *          ap_err;         // what went wrong, or NULL
+};
+
+/* FILE-SCOPE VARIABLES */
+static struct arith * table[NBUCKETS];  // compiled expressions, by text
+
+static struct ax_tok binops[] = {       // longer ones first
+    { "<<", AX_SHL, 6 },    { ">>", AX_SHR, 6 },
+    { "<=", AX_LE, 5 },     { ">=", AX_GE, 5 },
+    { "==", AX_EQ, 4 },     { "!=", AX_NE, 4 },
+    { "*", AX_MUL, 8 },     { "/", AX_DIV, 8 },     { "%", AX_MOD, 8 },
+    { "+", AX_ADD, 7 },     { "-", AX_SUB, 7 },
+    { "<", AX_LT, 5 },      { ">", AX_GT, 5 },
+    { "&", AX_BAND, 3 },    { "^", AX_BXOR, 2 },    { "|", AX_BOR, 1 },
+    { NULL, 0, 0 } };
+
+static struct ax_tok assigns[] = {      // longer ones first
+    { "<<=", AX_SHL, 0 },   { ">>=", AX_SHR, 0 },
+    { "*=", AX_MUL, 0 },    { "/=", AX_DIV, 0 },    { "%=", AX_MOD, 0 },
+    { "+=", AX_ADD, 0 },    { "-=", AX_SUB, 0 },
+    { "&=", AX_BAND, 0 },   { "^=", AX_BXOR, 0 },   { "|=", AX_BOR, 0 },
+    { "=", AX_SET, 0 },
+    { NULL, 0, 0 } };
+
+/* INTERNAL FUNCTIONS */
+static void parse_assign(struct ax_parse *);
+static void parse_cond(struct ax_parse *);
+static void parse_or(struct ax_parse *);
+static void parse_and(struct ax_parse *);
+static void parse_binary(struct ax_parse *, int);
+static void parse_unary(struct ax_parse *);
+static void parse_primary(struct ax_parse *);
+static struct ax_tok * match(struct ax_tok *, char *, char *);
+static int next_is(struct ax_parse *, char *);
+static int nest_in(struct ax_parse *);
+static void skip_blanks(struct ax_parse *);
+static int emit(struct ax_parse *, int, long, char *, size_t);
+static int get_num(struct ax_insn *, long *);
+static int binary(int, long, long, long *);
+static void free_expr(struct arith *);
+static unsigned hash(char *, size_t);
+static int ax_error(char *, struct arith *);
+
+/*
+ *  ax_scan()
+ *  Purpose: Find the end of an arithmetic expansion
+ *    Input: cp, just past the "$(("
+ *           end, the end of the line
+ *   Return: just past the "))" that ends it, or end if there is none
+ *     Note: Parentheses inside the expression nest, so the "))" that
+ *           counts is the first one outside all of them.
+ */
+char * ax_scan(char * cp, char * end)
+{
+    int depth = 0;
+
+    for ( ; cp < end; cp++)
+    {
+        if (*cp == '(')
+            depth++;
+        else if (*cp == ')' && depth > 0)
+            depth--;
+        else if (*cp == ')' && cp + 1 < end && cp[1] == ')')
+            return cp + 2;
+    }
+    return end;
+}
+
+/*
+ *  ax_compile()
+ *  Purpose: Get the compiled form of an expression, compiling it the first
+ *           time its text is seen
+ *    Input: text, len, what is between "$((" and the end found by
+ *           ax_scan(), so it ends with "))" if it was closed
+ *   Return: the expression, or NULL after a syntax error (reported)
+ */
+struct arith * ax_compile(char * text, size_t len)
+{
+    struct arith *ex, **headp;
+    struct ax_parse ps;
+
+    headp = &table[hash(text, len) & (NBUCKETS - 1)];
+    for (ex = *headp; ex != NULL; ex = ex->ax_next)
+        if (ex->ax_len == len && memcmp(ex->ax_text, text, len) == 0)
+            return ex;
+
+    ex = emalloc(sizeof(struct arith));
+    ex->ax_text = newstr(text, len);
+    ex->ax_len = len;
+    ex->ax_code = NULL;
+    ex->ax_ncode = 0;
+
+    ps.ap_cp = ex->ax_text;
+    ps.ap_end = ex->ax_text + len;
+    ps.ap_ex = ex;
+    ps.ap_nslots = 0;
+    ps.ap_depth = 0;
+    ps.ap_nest = 0;
+    ps.ap_err = NULL;
+
+    if (len < 2 || memcmp(ps.ap_end - 2, "))", 2) != 0)
+        ps.ap_err = "missing '))'";
+    else
+    {
+        ps.ap_end -= 2;
+        parse_assign(&ps);
+        skip_blanks(&ps);
+        if (ps.ap_err == NULL && ps.ap_cp < ps.ap_end)
+            ps.ap_err = "expecting EOF";
+    }
+
+    if (ps.ap_err != NULL)
+    {
+        ax_error(ps.ap_err, ex);
+        free_expr(ex);
+        return NULL;
+    }
+    ex->ax_next = *headp;
+    *headp = ex;
+    return ex;
+}
+
+/*
+ *  ax_value()
+ *  Purpose: Evaluate a compiled expression with the current variables
+ *    Input: ex, the expression, or NULL (it did not compile)
+ *   Return: its value as text, only good until the next call; or NULL
+ *           after an error (reported), or if ex is NULL
+ */
+char * ax_value(struct arith * ex)
+{
+    static char result[24];
+    long st[AX_STACK];
+    struct ax_insn *in;
+    char num[24];
+    int sp = 0, pc;
+
+    if (ex == NULL)
+        return NULL;
+
+    for (pc = 0; pc < ex->ax_ncode; pc++)
+    {
+        in = &ex->ax_code[pc];
+        if (is_binary(in->in_op))
+        {
+            sp--;
+            if (binary(in->in_op, st[sp - 1], st[sp], &st[sp - 1]) == -1)
+            {
+                ax_error("division by zero", ex);
+                return NULL;
+            }
+            continue;
+        }
+
+        switch (in->in_op)
+        {
+            case AX_NUM:    st[sp++] = in->in_val;                  break;
+            case AX_STATUS: st[sp++] = get_exit();                  break;
+            case AX_PID:    st[sp++] = getpid();                    break;
+            case AX_NEG:    st[sp - 1] = -(unsigned long) st[sp - 1]; break;
+            case AX_NOT:    st[sp - 1] = !st[sp - 1];               break;
+            case AX_BNOT:   st[sp - 1] = ~st[sp - 1];               break;
+            case AX_BOOL:   st[sp - 1] = (st[sp - 1] != 0);         break;
+            case AX_JMP:    pc = in->in_val - 1;                    break;
+            case AX_VAR:
+                if (get_num(in, &st[sp++]) == -1)
+                {
+                    ax_error("Illegal number", ex);
+                    return NULL;
+                }
+                break;
+            case AX_SET:
+                snprintf(num, sizeof(num), "%ld", st[sp - 1]);
+                VLstore(in->in_name, num);
+                break;
+            case AX_ANDJ:
+                if (st[sp - 1] == 0)
+                    pc = in->in_val - 1;
+                else
+                    sp--;
+                break;
+            case AX_ORJ:
+                if (st[sp - 1] != 0)
+                {
+                    st[sp - 1] = 1;
+                    pc = in->in_val - 1;
+                }
+                else
+                    sp--;
+                break;
+            case AX_JZ:
+                if (st[--sp] == 0)
+                    pc = in->in_val - 1;
+                break;
+        }
+    }
+
+    snprintf(result, sizeof(result), "%ld", st[0]);
+    return result;
+}
+
+/*
+ *  parse_assign()
+ *  Purpose: Compile an expression at the lowest level: an assignment
+ *           ("x = e", "x += e", ...), or else a conditional one
+ *     Note: For "x op= e" the code is x, e, op, then the store. Each
+ *           call is a level of nesting (see nest_in()).
+ */
+void parse_assign(struct ax_parse * ps)
+{
+    char *name, *cp;
+    size_t nlen;
+    struct ax_tok *tk;
+
+    if (!nest_in(ps))
+        return;
+    skip_blanks(ps);
+    name = cp = ps->ap_cp;
+    if (cp < ps->ap_end && is_namech(*cp) && !isdigit((unsigned char) *cp))
+    {
+        while (cp < ps->ap_end && is_namech(*cp))
+            cp++;
+        nlen = cp - name;
+        while (cp < ps->ap_end && is_blank(*cp))
+            cp++;
+        tk = match(assigns, cp, ps->ap_end);
+        if (tk != NULL && !(tk->tk_op == AX_SET && cp[1] == '='))
+        {                                   // not "=="
+            ps->ap_cp = cp + strlen(tk->tk_text);
+            if (tk->tk_op != AX_SET)
+                emit(ps, AX_VAR, 0, name, nlen);
+            parse_assign(ps);
+            if (tk->tk_op != AX_SET)
+                emit(ps, tk->tk_op, 0, NULL, 0);
+            emit(ps, AX_SET, 0, name, nlen);
+            ps->ap_nest--;
+            return;
+        }
+    }
+    parse_cond(ps);
+    ps->ap_nest--;
+}
+
+/*
+ *  parse_cond()
+ *  Purpose: Compile "c ? a : b", or just what is above it
+ *     Note: The code is c, JZ to b, a, JMP past b, b.
+ */
+void parse_cond(struct ax_parse * ps)
+{
+    int jz, jmp;
+
+    parse_or(ps);
+    if (ps->ap_err != NULL || !next_is(ps, "?"))
+        return;
+
+    jz = emit(ps, AX_JZ, 0, NULL, 0);
+    parse_assign(ps);
+    jmp = emit(ps, AX_JMP, 0, NULL, 0);
+    ps->ap_depth--;                         // b takes the place of a
+    ps->ap_ex->ax_code[jz].in_val = ps->ap_ex->ax_ncode;
+
+    if (ps->ap_err == NULL && !next_is(ps, ":"))
+        ps->ap_err = "expecting ':'";
+    if (ps->ap_err != NULL || !nest_in(ps))
+        return;
+    parse_cond(ps);
+    ps->ap_nest--;
+    ps->ap_ex->ax_code[jmp].in_val = ps->ap_ex->ax_ncode;
+}
+
+/*
+ *  parse_or()
+ *  Purpose: Compile "a || b || ...", evaluating b only if a is 0
+ */
+void parse_or(struct ax_parse * ps)
+{
+    int jump;
+
+    parse_and(ps);
+    while (ps->ap_err == NULL && next_is(ps, "||"))
+    {
+        jump = emit(ps, AX_ORJ, 0, NULL, 0);
+        parse_and(ps);
+        emit(ps, AX_BOOL, 0, NULL, 0);
+        ps->ap_ex->ax_code[jump].in_val = ps->ap_ex->ax_ncode;
+    }
+}
+
+/*
+ *  parse_and()
+ *  Purpose: Compile "a && b && ...", evaluating b only if a is not 0
+ */
+void parse_and(struct ax_parse * ps)
+{
+    int jump;
+
+    parse_binary(ps, 1);
+    while (ps->ap_err == NULL && next_is(ps, "&&"))
+    {
+        jump = emit(ps, AX_ANDJ, 0, NULL, 0);
+        parse_binary(ps, 1);
+        emit(ps, AX_BOOL, 0, NULL, 0);
+        ps->ap_ex->ax_code[jump].in_val = ps->ap_ex->ax_ncode;
+    }
+}
+
+/*
+ *  parse_binary()
+ *  Purpose: Compile the binary operators from '|' up to '*', by
+ *           precedence climbing
+ *    Input: minprec, the loosest operator that may be taken here
+ */
+void parse_binary(struct ax_parse * ps, int minprec)
+{
+    struct ax_tok *tk;
+    char *cp;
+
+    parse_unary(ps);
+    while (ps->ap_err == NULL)
+    {
+        skip_blanks(ps);
+        cp = ps->ap_cp;
+        tk = match(binops, cp, ps->ap_end);
+        if (tk == NULL || tk->tk_prec < minprec)
+            return;
+        if (tk->tk_text[1] == '\0' && cp + 1 < ps->ap_end &&
+            (cp[1] == '=' || ((*cp == '&' || *cp == '|') && cp[1] == *cp)))
+            return;                         // "+=", "&&", ...: not this
+        ps->ap_cp += strlen(tk->tk_text);
+        parse_binary(ps, tk->tk_prec + 1);  // all of them group left
+        emit(ps, tk->tk_op, 0, NULL, 0);
+    }
+}
+
+/*
+ *  parse_unary()
+ *  Purpose: Compile a primary with any of + - ! ~ in front of it
+ */
+void parse_unary(struct ax_parse * ps)
+{
+    char c;
+
+    skip_blanks(ps);
+    c = (ps->ap_cp < ps->ap_end ? *ps->ap_cp : '\0');
+    if (c != '+' && c != '-' && c != '!' && c != '~')
+    {
+        parse_primary(ps);
+        return;
+    }
+
+    ps->ap_cp++;
+    if (!nest_in(ps))
+        return;
+    parse_unary(ps);
+    ps->ap_nest--;
+    if (c == '-')
+        emit(ps, AX_NEG, 0, NULL, 0);
+    else if (c == '!')
+        emit(ps, AX_NOT, 0, NULL, 0);
+    else if (c == '~')
+        emit(ps, AX_BNOT, 0, NULL, 0);
+}
+
+/*
+ *  parse_primary()
+ *  Purpose: Compile a number, a variable, or an expression in ( )
+ */
+void parse_primary(struct ax_parse * ps)
+{
+    char *cp = ps->ap_cp, *end = ps->ap_end, *name;
+    long val;
+
+    if (cp < end && *cp == '(')
+    {
+        ps->ap_cp++;
+        parse_assign(ps);
+        if (ps->ap_err == NULL && !next_is(ps, ")"))
+            ps->ap_err = "expecting ')'";
+    }
+    else if (cp < end && isdigit((unsigned char) *cp))
+    {
+        val = strtol(cp, &ps->ap_cp, 0);    // stops at the "))" at worst
+        emit(ps, AX_NUM, val, NULL, 0);
+    }
+    else if (cp + 1 < end && *cp == '$' && (cp[1] == '?' || cp[1] == '$'))
+    {
+        emit(ps, cp[1] == '?' ? AX_STATUS : AX_PID, 0, NULL, 0);
+        ps->ap_cp += 2;
+    }
+    else
+    {
+        if (cp < end && *cp == '$')         // $x is the same as x
+            cp++;
+        for (name = cp; cp < end && is_namech(*cp); cp++)
+            ;
+        if (cp == name)
+            ps->ap_err = "expecting primary";
+        else
+        {
+            emit(ps, AX_VAR, 0, name, cp - name);
+            ps->ap_cp = cp;
+        }
+    }
+}
+
+/*
+ *  match()
+ *  Purpose: Find the operator in a table that is written at cp
+ *   Return: its entry, or NULL
+ */
+struct ax_tok * match(struct ax_tok * tab, char * cp, char * end)
+{
+    size_t len;
+
+    for ( ; tab->tk_text != NULL; tab++)
+    {
+        len = strlen(tab->tk_text);
+        if ((size_t) (end - cp) >= len && memcmp(cp, tab->tk_text, len) == 0)
+            return tab;
+    }
+    return NULL;
+}
+
+/*
+ *  next_is()
+ *  Purpose: Read the token s if it comes next (after any blanks)
+ *   Return: 1 if it was there (and is now read), 0 if not
+ */
+int next_is(struct ax_parse * ps, char * s)
+{
+    size_t len = strlen(s);
+
+    skip_blanks(ps);
+    if ((size_t) (ps->ap_end - ps->ap_cp) < len ||
+        memcmp(ps->ap_cp, s, len) != 0)
+        return 0;
+    ps->ap_cp += len;
+    return 1;
+}
+
+/*
+ *  nest_in()
+ *  Purpose: Count one more level of parse_*() calls inside each other
+ *   Return: 1 if it was counted (the caller takes it off again when it
+ *           returns), or 0 with the error set if there are too many
+ *     Note: "((((...", "- - - ..." and "a = b = ..." each go one level
+ *           deeper, and none of them has to put a value on the stack, so
+ *           emit() would not stop them before the C stack runs out.
+ */
+int nest_in(struct ax_parse * ps)
+{
+    if (ps->ap_nest == AX_NEST)
+    {
+        if (ps->ap_err == NULL)
+            ps->ap_err = "expression nested too deeply";
+        return 0;
+    }
+    ps->ap_nest++;
+    return 1;
+}
+
+/*
+ *  skip_blanks()
+ *  Purpose: Move past blanks (and newlines) in the expression
+ */
+void skip_blanks(struct ax_parse * ps)
+{
+    while (ps->ap_cp < ps->ap_end && is_blank(*ps->ap_cp))
+        ps->ap_cp++;
+}
+
+/*
+ *  emit()
+ *  Purpose: Add an instruction to the expression being compiled, and keep
+ *           count of how deep the stack gets
+ *    Input: op, the instruction
+ *           val, its number or jump target
+ *           name, nlen, the variable it uses (copied), or NULL
+ *   Return: where it is in ax_code, so a jump can be pointed later
+ */
+int emit(struct ax_parse * ps, int op, long val, char * name, size_t nlen)
+{
+    struct arith *ex = ps->ap_ex;
+    struct ax_insn *in;
+
+    if (ex->ax_ncode == ps->ap_nslots)
+    {
+        ps->ap_nslots = (ps->ap_nslots == 0 ? 8 : 2 * ps->ap_nslots);
+        ex->ax_code = erealloc(ex->ax_code,
+                               ps->ap_nslots * sizeof(struct ax_insn));
+    }
+
+    in = &ex->ax_code[ex->ax_ncode];
+    in->in_op = op;
+    in->in_val = val;
+    in->in_name = (name != NULL ? newstr(name, nlen) : NULL);
+    in->in_len = nlen;
+
+    if (op == AX_NUM || op == AX_VAR || op == AX_STATUS || op == AX_PID)
+        ps->ap_depth++;
+    else if (is_binary(op) || op == AX_ANDJ || op == AX_ORJ || op == AX_JZ)
+        ps->ap_depth--;
+    if (ps->ap_depth > AX_STACK && ps->ap_err == NULL)
+        ps->ap_err = "expression too deep";
+
+    return ex->ax_ncode++;
+}
+
+/*
+ *  get_num()
+ *  Purpose: Read the value of a variable as a number
+ *   Return: 0 with *valp set, or -1 if the value is not a number
+ *     Note: Unset or empty is 0. Octal and hex are read as in the text.
+ */
+int get_num(struct ax_insn * in, long * valp)
+{
+    char *val = VLlookupn(in->in_name, in->in_len);
+    char *rest;
+
+    while (is_blank(*val))
+        val++;
+    if (*val == '\0')
+    {
+        *valp = 0;
+        return 0;
+    }
+
+    *valp = strtol(val, &rest, 0);
+    while (is_blank(*rest))
+        rest++;
+    return (rest == val || *rest != '\0' ? -1 : 0);
+}
+
+/*
+ *  binary()
+ *  Purpose: Apply a binary operator
+ *   Return: 0 with *rp set, or -1 on a division by zero
+ *     Note: + - * wrap around instead of overflowing, the width of a
+ *           shift is taken mod 64, and the smallest number / -1 is itself,
+ *           so no expression can make the shell crash.
+ */
+int binary(int op, long a, long b, long * rp)
+{
+    unsigned long ua = a, ub = b;
+
+    if ((op == AX_DIV || op == AX_MOD) && b == 0)
+        return -1;
+
+    switch (op)
+    {
+        case AX_MUL:    *rp = ua * ub;                              break;
+        case AX_DIV:    *rp = (b == -1 ? (long) -ua : a / b);       break;
+        case AX_MOD:    *rp = (b == -1 ? 0 : a % b);                break;
+        case AX_ADD:    *rp = ua + ub;                              break;
+        case AX_SUB:    *rp = ua - ub;                              break;
+        case AX_SHL:    *rp = ua << (b & 63);                       break;
+        case AX_SHR:    *rp = a >> (b & 63);                        break;
+        case AX_LT:     *rp = a < b;                                break;
+        case AX_LE:     *rp = a <= b;                               break;
+        case AX_GT:     *rp = a > b;                                break;
+        case AX_GE:     *rp = a >= b;                               break;
+        case AX_EQ:     *rp = a == b;                               break;
+        case AX_NE:     *rp = a != b;                               break;
+        case AX_BAND:   *rp = a & b;                                break;
+        case AX_BXOR:   *rp = a ^ b;                                break;
+        case AX_BOR:    *rp = a | b;                                break;
+    }
+    return 0;
+}
+
+/*
+ *  free_expr()
+ *  Purpose: Release an expression that did not compile
+ */
+void free_expr(struct arith * ex)
+{
+    int i;
+
+    for (i = 0; i < ex->ax_ncode; i++)
+        free(ex->ax_code[i].in_name);
+    free(ex->ax_code);
+    free(ex->ax_text);
+    free(ex);
+}
+
+/*
+ *  hash()
+ *  Purpose: FNV-1a hash of an expression's text, for its chain in table[]
+ */
+unsigned hash(char * s, size_t len)
+{
+    unsigned h = 2166136261u;
+
+    while (len-- > 0)
+    {
+        h ^= (unsigned char) *s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/*
+ *  ax_error()
+ *  Purpose: Report an error in an expression, with its text, as dash does
+ *   Return: -1, with $? set to 2; in a script, the shell exits instead
+ */
+int ax_error(char * msg, struct arith * ex)
+{
+    char buf[256];
+    int len = ex->ax_len;
+
+    if (len >= 2 && memcmp(ex->ax_text + len - 2, "))", 2) == 0)
+        len -= 2;
+    snprintf(buf, sizeof(buf), "%s: \"%.*s\"", msg, len, ex->ax_text);
+
+    complain("arithmetic expression: %s\n", buf);
+    if (get_mode() == SCRIPTED)                 // not fatal(): its own words
+        shell_exit(2);
+    set_exit(2);
+
+    return -1;
+}
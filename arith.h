@@ -0,0 +1,19 @@
+/*
+ * ==========================
+ *   FILE: ./arith.h
+ * ==========================
+ * Purpose: Header file for arith.c
+ */
+
+#ifndef	ARITH_H
+#define	ARITH_H
+
+#include    <stddef.h>
+
+struct arith;                   // a compiled expression (see arith.c)
+
+char * ax_scan(char *cp, char *end);
+struct arith * ax_compile(char *text, size_t len);
+char * ax_value(struct arith *ex);
+
+#endif
@@ -4,18 +4,22 @@
  * ==========================
  * Purpose: contains the switch and the functions for builtin commands
  *
- * Copied from starter code. is_builtin() was modified to includes tests
- * for the new built-in functions written for the assignment. Other
- * functions were unmodified. New functions are as follows:
+ * Copied from starter code. is_builtin() no longer tries each builtin in
+ * turn: it looks args[0] up in the table of names in cmdtable.c, which says
+ * which function runs it. New functions are as follows:
  *      is_exit()         -- Terminate shell
  *      is_cd()           -- Change directories
  *      is_read()         -- Assign input from stdin to a variable
- *      varsub()          -- Do variable substitution
+ *      is_hash()         -- List, add to or clear the command path cache
+ *      is_wait()         -- Wait for background jobs
+ * echo, test and [, true, false and printf are also built in; they are in
+ * utilities.c.
+ *      is_builtin_cmd()  -- Would is_builtin() run a command? (pipelines)
+ *      set_builtin_input() -- Where 'read' reads from (pipelines)
  * The following are internal helper functions:
- *      get_replacement() -- Get string to replace a $VARIABLE
- *      get_special()     -- Convert a number to a string
- *      get_var()         -- Extract a valid variable name, to be replaced
  *      get_number()      -- Helper function to check if str is a number
+ * Variable substitution (varsub()) used to live here too; it is now done
+ * while the line is split into words, by lex_line() in lexer.c.
  */
 
 /* INCLUDES */
@@ -28,14 +32,17 @@
 #include    <stdbool.h>
 #include    "smsh.h"
 #include    "varlib.h"
-#include    "flexstr.h"
 #include    "splitline.h"
 #include    "builtin.h"
+#include    "pathcache.h"
+#include    "jobs.h"
+#include    "cmdtable.h"
+#include    "cmdsub.h"
+
+/* FILE-SCOPE VARIABLES */
+static FILE * input = NULL;         // what 'read' reads; NULL means stdin
 
 /* INTERNAL FUNCTIONS */
-static char * get_replacement(char * args, int * len);
-static char * get_special(int val);
-static char * get_var(char *args, int * len);
 static int get_number(char * str);
 
 
@@ -43,65 +50,90 @@ int is_builtin(char **args, int *resultp)
 /*
  * purpose: run a builtin command 
  * returns: 1 if args[0] is builtin, 0 if not
- * details: test args[0] against all known builtins.  Call functions
+ * details: look args[0] up in the table of builtins (cmdtable.c) and
+ *          call its function; failing that, it may be an assignment
  */
 {
-    if ( is_exit(args, resultp) )           // added for assignment
-        return 1;
-    if ( is_assign_var(args[0], resultp) )
-        return 1;
-    if ( is_list_vars(args[0], resultp) )
-        return 1;
-    if ( is_export(args, resultp) )
-        return 1;
-    if ( is_cd(args, resultp) )             // added for assignment
+    struct command *cp = cmd_lookup(args[0], strlen(args[0]));
+
+    if ( cp != NULL && cp->cm_run != NULL ){
+        cp->cm_run(args, resultp);
         return 1;
-    if ( is_read(args, resultp) )           // added for assignment
+    }
+    return is_assign_var(args[0], resultp);
+}
+
+/*
+ *  is_builtin_cmd()
+ *  Purpose: Tell whether is_builtin() would take a command, without
+ *           running it (a pipeline has to know before it starts anything)
+ *    Input: args, command line arguments
+ *   Return: 1 if args[0] is a builtin or a legal assignment, 0 if not
+ */
+int is_builtin_cmd(char **args)
+{
+    struct command *bp = cmd_lookup(args[0], strlen(args[0]));
+    char *cp;
+    int ok;
+
+    if ( bp != NULL && bp->cm_run != NULL )
         return 1;
-    return 0;
+
+    if ( (cp = strchr(args[0], '=')) == NULL )
+        return 0;
+    *cp = '\0';                             // same test as assign()
+    ok = okname(args[0]);
+    *cp = '=';
+    return ok;
+}
+
+/*
+ *  set_builtin_input()
+ *  Purpose: Make 'read' read from a stream other than stdin
+ *    Input: fp, the stream, or NULL to go back to stdin
+ */
+void set_builtin_input(FILE *fp)
+{
+    input = fp;
 }
 
 /* checks if a legal assignment cmd
  * if so, does it and retns 1
  * else return 0
+ * the status is that of the last $(...) in the line, if there was one
  */
 int is_assign_var(char *cmd, int *resultp)
 {
     if ( strchr(cmd, '=') != NULL ){
         *resultp = assign(cmd);
+        if ( *resultp == 0 && cs_ran() )    // x=$(cmd): its status, as in sh
+            *resultp = get_exit();
         if ( *resultp != -1 )
             return 1;
     }
     return 0;
 }
 
-/* checks if command is "set" : if so list vars */
-int is_list_vars(char *cmd, int *resultp)
+/* the "set" command : list vars */
+int is_list_vars(char **args, int *resultp)
 {
-    if ( strcmp(cmd,"set") == 0 ){       /* 'set' command? */
-        VLlist();
-        *resultp = 0;
-        return 1;
-    }
-    return 0;
+    VLlist();
+    *resultp = 0;
+    return 1;
 }
 
 /*
- * if an export command, then export it and ret 1
- * else ret 0
+ * the export command: export it and ret 1
  * note: the opengroup says
  *  "When no arguments are given, the results are unspecified."
  */
 int is_export(char **args, int *resultp)
 {
-    if ( strcmp(args[0], "export") == 0 ){
-        if ( args[1] != NULL && okname(args[1]) )
-            *resultp = VLexport(args[1]);
-        else
-            *resultp = 1;
-        return 1;
-    }
-    return 0;
+    if ( args[1] != NULL && okname(args[1]) )
+        *resultp = VLexport(args[1]);
+    else
+        *resultp = 1;
+    return 1;
 }
 
 /*
@@ -109,28 +141,27 @@ int is_export(char **args, int *resultp)
  *  Purpose: change directories
  *    Input: args, command line arguments
  *           resultp, where to store result of cd operation
- *   Return: 1 if built-in function, 0 otherwise. resultp is 0
+ *   Return: 1 (it is a built-in function). resultp is 0
  *           if chdir() was successful, 2 on (syntax) error.
+ *     Note: Commands found through a relative PATH dir are forgotten
+ *           after a successful cd (see pc_chdir()).
  */
 int is_cd(char **args, int *resultp)
 {
-    if ( strcmp(args[0], "cd") == 0 )
+    if (args[1] != NULL)
+        *resultp = chdir(args[1]);                  // go to dir specified
+    else
+        *resultp = chdir(VLlookup("HOME"));         // go to HOME directory
+
+    if( *resultp == -1)                             // chdir failed
     {
-        if (args[1] != NULL)
-            *resultp = chdir(args[1]);              // go to dir specified
-        else
-            *resultp = chdir(VLlookup("HOME"));     // go to HOME directory
-        
-        
-        if( *resultp == -1)                         // chdir failed
-        {
-            fprintf(stderr, "cd: %s: %s\n",
-                            args[1], strerror(errno));
-            *resultp = 2;                           // syntax error
-        }
-        return 1;                                   //was a built-in
+        complain("cd: %s: %s\n",
+                        args[1], strerror(errno));
+        *resultp = 2;                               // syntax error
     }
-    return 0;
+    else
+        pc_chdir();                                 // "./prog" moved
+    return 1;                                       //was a built-in
 }
 
 
@@ -141,60 +172,118 @@ int is_cd(char **args, int *resultp)
  *           resultp, where to store result of exit operation
  *   Return: If there is a syntax error, resultp is assigned a value of 2
  *           and is_exit() returns with 1 to indicate 'exit' was called.
- *           Otherwise, exit() is called with the status specified on the
- *           command line, or with the exit status of the preceding command.
+ *           Otherwise, the shell exits (see shell_exit()) with the status
+ *           specified on the command line, or with the exit status of the
+ *           preceding command.
  */
 int is_exit(char **args, int *resultp)
 {
-    if( strcmp(args[0], "exit") == 0)
+    if( args[1] != NULL )               // exit arg specified?
     {
-        if( args[1] != NULL )               // exit arg specified?
-        {
-            int val = get_number(args[1]);  // convert to a number
+        int val = get_number(args[1]);  // convert to a number
 
-            if (val != -1)                  // successful?
-                exit(val);                  // use it
-            else                            // syntax error
-            {
-                fprintf(stderr, "exit: Illegal number: %s\n", args[1]);
-                *resultp = 2;
-            }
-        }
-        else
+        if (val != -1)                  // successful?
+            shell_exit(val);            // use it
+        else                            // syntax error
         {
-            exit( get_exit() );         //exit with last command's status   
+            complain("exit: Illegal number: %s\n", args[1]);
+            *resultp = 2;
         }
-        
-        return 1;                       //was a built-in
     }
-    return 0;
+    else
+    {
+        shell_exit( get_exit() );       //exit with last command's status
+    }
+
+    return 1;                           //was a built-in
 }
 
 /*
  *  is_read()
  *  Purpose: Assign input from stdin to the name of a specified variable
+ *           (next_cmd() reads up to the '\n'; in a pipeline, input comes
+ *           from the stage before, see set_builtin_input())
  *    Input: args, command line arguments
  *           resultp, where to store result of read operation
- *   Return: result
+ *   Return: 1; resultp is the result: 1 at end of input (the variable is
+ *           set to ""), as in sh, so "while read x" loops stop
+ *     Note: stdout is flushed first, as start_command() does, so a prompt
+ *           echoed before 'read' shows up before it waits for input.
  */
 int is_read(char **args, int *resultp)
 {    
-    if ( strcmp(args[0], "read") == 0)
+    fflush(stdout);                             // a prompt printed by echo
+    if( args[1] != NULL && okname(args[1]) )    // check if a valid var name
     {
-        if( args[1] != NULL && okname(args[1]) ) // check if a valid var name
-        {           
-            char * str = next_cmd("", stdin);    // next_cmd reads until '\n'
-            *resultp = VLstore(args[1], str);
-        }
-        else                                     // syntax error
-        {
-            fprintf(stderr, "read: %s: bad variable name\n", args[1]);
-            *resultp = 2;
-        }
-        return 1;
+        char * str = next_cmd("", input != NULL ? input : stdin);
+        *resultp = VLstore(args[1], str != NULL ? str : "");
+        if ( str == NULL && *resultp == 0 )     // end of input
+            *resultp = 1;
+        free(str);                              // VLstore() made a copy
     }
-    
-    return 0;
+    else                                        // syntax error
+    {
+        complain("read: %s: bad variable name\n", args[1]);
+        *resultp = 2;
+    }
+    return 1;
+}
+
+/*
+ *  is_hash()
+ *  Purpose: The 'hash' builtin, as in dash:
+ *               hash          -- list where known commands are
+ *               hash -r       -- forget them all
+ *               hash name ... -- look names up now and remember them
+ *    Input: args, command line arguments
+ *           resultp, where to store result of hash operation
+ *   Return: 1 (it is a built-in function). resultp is 0 if ok,
+ *           1 if a name was not found.
+ */
+int is_hash(char **args, int *resultp)
+{
+    int i;
+
+    *resultp = 0;
+    if ( args[1] == NULL )
+        pc_list();
+    else if ( strcmp(args[1], "-r") == 0 )
+        pc_clear();
+    else
+        for (i = 1; args[i] != NULL; i++)
+            if ( pc_lookup(args[i]) == NULL )
+            {
+                complain("hash: %s: not found\n", args[i]);
+                *resultp = 1;
+            }
+    return 1;
+}
+
+/*
+ *  is_wait()
+ *  Purpose: The 'wait' builtin:
+ *               wait          -- wait for every background job
+ *               wait pid ...  -- wait for those jobs
+ *    Input: args, command line arguments
+ *           resultp, where to store result of wait operation
+ *   Return: 1 (it is a built-in function). resultp is 0 with no
+ *           pids, else the status of the last one (127 if it is not a
+ *           job of this shell).
+ */
+int is_wait(char **args, int *resultp)
+{
+    int i, pid;
+
+    *resultp = 0;
+    if ( args[1] == NULL )
+        job_waitall();
+    for (i = 1; args[i] != NULL; i++)
+    {
+        pid = get_number(args[i]);
+        if ( pid <= 0 || job_wait(pid, resultp) == -1 )
+            *resultp = 127;
+    }
+    return 1;
 }
 
 int assign(char *str)
@@ -229,164 +318,6 @@ int okname(char *str)
     return ( cp != str );   /* no empty strings, either */
 }
 
-#define is_delim(x) ((x)==' '|| (x)=='\t' || (x)=='\0')
-
-/*
- *  varsub()
- *  Purpose: Check line for escape-chars, comments, and any variable subs
- *    Input: args, un-modified cmdline input
- *   Return: a copy of the modified cmdline
- *   Method: If not NULL, varsub() iterates over every char in the cmdline
- *           that is passed in. If it does not match a special case - either
- *           a comment (#), a literal-next (\), or a variable ($) - the char
- *           is untouched. For the special cases, a comment is valid if the
- *           previous character is whitespace. Here, the rest of the line is
- *           ignored. For a literal next, if a next char exists, it is output
- *           as-is; if the '\' is the last char, the backslash is output
- *           (note: most shells would traditional treat a backslash at the
- *           end of a line to look for continuation of input on the next line.
- *           As noted in Piazza post @282, this is not required for the
- *           assignment). For variable substitution, it calls on
- *           get_replacement() to get a string to append. For more info on
- *           how that works, see header comments below.
- */
-char * varsub(char * args)
-{
-    int skipped;
-    char c, prev;
-    char *newstr, *retval;
-    
-    if (args == NULL)
-        return NULL;
-
-    FLEXSTR s;
-    fs_init(&s, 0);
-    
-    while ( (c = args[0]) )                     // go through cmdline
-    {
-        if (c == '#' && is_delim(prev) )        // start of comment
-            break;                              // ignore the rest
-        else if (c == '\\' && args[1])          // escape char
-        {
-            fs_addch(&s, args[1]);              // add the literal next
-            args++;
-        }
-        else if (c == '$')                      // variable sub
-        {
-            newstr = get_replacement(++args, &skipped);
-            args += (skipped - 1);              // -1 because args++ below
-            fs_addstr(&s, newstr);
-        }
-        else                                    // regular char
-            fs_addch(&s, c);                    // add as-is
-        
-        prev = c;
-        args++;
-    }
-    
-    fs_addch(&s, '\0');                         // terminate string
-    retval = fs_getstr(&s);                     // get a copy of the string
-    fs_free(&s);                                // release fs memory
-    return retval;
-}
-
-/*
- *  get_replacement()
- *  Purpose: Return a string that will replace a $VARIABLE in a command line
- *    Input: args, the command line from the start of the variable to sub
- *           len, pointer the varsub uses to know where the end of the
- *                is located
- *   Return: String to substitute in place for the $VARIABLE
- *   Method: First, call get_var() to get the 'name' of the valid variable
- *           to replace. get_var() reads in chars until it finds a non-
- *           alpha-numeric or underscore char. It then evaluates the variable
- *           and performs a varlib lookup, or calls get_special() for the $$
- *           or $? variables.
- */
-char * get_replacement(char * args, int * len)
-{
-    // get the variable to replace
-    char * to_replace = get_var(args, len);     //++args to trim '$' from head
-    char *retval;
-    
-    if (strcmp(to_replace, "$") == 0)           // special PID var
-        retval = get_special(getpid());
-    else if (strcmp(to_replace, "?") == 0)      // special exit-status var
-        retval = get_special(get_exit());
-    else                                        // environment var
-        retval = VLlookup(to_replace);
-        
-    free(to_replace);
-    return retval;
-}
-
-/*
- *  get_special()
- *  Purpose: Convert a number to a string
- *    Input: val, the value of a special variable $$ or $?
- *   Return: A stringified version of the special value passed in
- */
-char * get_special(int val)
-{
-    char special[sizeof(pid_t) * sizeof(int)] = "";
-
-    if (sprintf(special, "%d", val) < 0)        // sprintf error
-        return "";                              // return empty string
-
-    FLEXSTR var;
-    fs_init(&var, 0);
-    fs_addstr(&var, special);                   // number was converted
-    fs_addch(&var, '\0');                       // terminate
-    
-    char *retval = fs_getstr(&var);             // get a copy of the string
-    fs_free(&var);                              // release fs memory
-    return retval;  
-}
-
-/*
- *  get_var()
- *  Purpose: Extract a valid variable name, to be replaced
- *    Input: args, the command line from the start of the variable to sub
- *           len, pointer the varsub uses to know where the end of the
- *                is located
- *   Return: String the contains name of variable to be replaced.
- *     Note: The code always adds one char to the var string. While this
- *           works for most cases, and ensures special variables can work,
- *           the solution is not ideal. It is extra code that could probably
- *           be incorporated into the while loop, and it does not catch error
- *           condition that variable names cannot begin with a digit (for
- *           this shell assignment).
- */
-char * get_var(char *args, int * len)
-{
-    char c;
-    int skipped = 0;
-    FLEXSTR var;
-    fs_init(&var, 0);
-    fs_addch(&var, args[0]);        //add at least one char (could be $ or ?)
-    skipped++;
-    args++;
-    
-    while ( (c = args[0]) )
-    {
-        if( isalnum(c) || c == '_')             // valid?
-            fs_addch(&var, c);                  // add it
-        else
-            break;                              // stop
-        
-        skipped++;
-        args++;
-    }
-    
-    fs_addch(&var, '\0');                   // terminate
-    *len = skipped;                         // pass back position
-    char *retval = fs_getstr(&var);         // get a copy of the string
-    fs_free(&var);                          // release fs memory
-    return retval;
-}
-
-
-
 /*
  *  get_number()
  *  Purpose: Helper function to check if str is a number
@@ -8,20 +8,24 @@
 #ifndef	BUILTIN_H
 #define	BUILTIN_H
 
+#include    <stdio.h>
+
 int is_builtin(char **args, int *resultp);
+int is_builtin_cmd(char **args);
+void set_builtin_input(FILE *fp);
 int is_assign_var(char *cmd, int *resultp);
-int is_list_vars(char *cmd, int *resultp);
+int is_list_vars(char **args, int *resultp);
 int is_export(char **, int *);
 
 int assign(char *);
 int okname(char *);
 
-// Added built-in functions
+// Added built-in functions; each one is only called for its own name
+// (see cmdtable.c)
 int is_exit(char **args, int *resultp);
 int is_cd(char **args, int *resultp);
 int is_read(char **args, int *resultp);
-
-// Added variable substitution
-char * varsub(char * args);
+int is_hash(char **args, int *resultp);
+int is_wait(char **args, int *resultp);
 
 #endif
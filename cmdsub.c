@@ -0,0 +1,327 @@
+/*
+ * ==========================
+ *   FILE: ./cmdsub.c
+ * ==========================
+ * Purpose: Command substitution: $(command) and `command` are replaced by
+ *          what the command prints.
+ *
+ * Outline: lex_line() and tm_compile() find a substitution with cs_scan(),
+ * which gives back the text of the command in it. cs_run() runs that
+ * command and returns its output with the newlines at the end taken off;
+ * the caller splits it into words as it does a variable's value, except
+ * in an assignment, where m=$(seq 3) keeps all of the output. Output is
+ * read straight into one FLEXSTR that is kept from one substitution to the
+ * next, so once it has grown to fit, capturing costs the read()s and
+ * nothing more: no temp files, and no copying a byte at a time.
+ *
+ * How the command is run depends on what it is:
+ *      - a program: started by start_command() with its stdout on a pipe,
+ *        which the shell reads until the program is done with it
+ *      - a pure builtin (echo, test, printf, ...; see cmdtable.c): run in
+ *        the shell with stdout on a memfd, which is read back in one
+ *        pread() and then emptied to be used again by the next one
+ *      - anything else (a pipeline, a job, a builtin that changes the
+ *        shell such as cd or x=1): run in a forked child with its stdout
+ *        on a pipe, so that, as in sh, what it changes is lost
+ * The command's words are substituted by the shell before it is started,
+ * so substitutions inside it are done first. $? is set to its status,
+ * and a line that is only an assignment, x=$(cmd), keeps that status as
+ * its own, as in sh (cs_ran() tells is_assign_var() whether one was run).
+ *
+ * interface:
+ *      cs_scan(cp, end, quote, &cmd)  -- find the end of a substitution
+ *      cs_run(cmd, len)               -- run its command; get the output
+ *      cs_begin()                     -- a new line is being expanded
+ *      cs_ran()                       -- was a substitution run in it?
+ */
+
+/* INCLUDES */
+#define     _GNU_SOURCE                 // pipe2()
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <errno.h>
+#include    <unistd.h>
+#include    <fcntl.h>
+#include    <sys/types.h>
+#include    "smsh.h"
+#include    "flexstr.h"
+#include    "builtin.h"
+#include    "cmdtable.h"
+#include    "lexer.h"
+#include    "spawner.h"
+#include    "process.h"
+#include    "pipeline.h"
+#include    "jobs.h"
+#include    "arena.h"
+#include    "cmdsub.h"
+
+/* CONSTANTS */
+#define CS_CHUNK    4096                // least room to read() into
+
+/* FILE-SCOPE VARIABLES */
+static FLEXSTR out;                     // the output, kept between calls
+static int out_ready = 0;
+static int mfd = -1;                    // memfd for pure builtins
+static pid_t mfd_pid = 0;               // the process that made it
+static int ran = 0;                     // one was run in the current line
+
+/* INTERNAL FUNCTIONS */
+static int is_pure(char **);
+static int run_program(char **);
+static int run_pure(char **, int *);
+static int run_forked(char **);
+static void read_all(int);
+
+/*
+ *  cs_scan()
+ *  Purpose: Find the end of a substitution and collect its command
+ *    Input: cp, just past the "$(" or '`'
+ *           end, the end of the line
+ *           quote, what ends it: ')' or '`'
+ *           cmd, where to add the text of the command, or NULL to only
+ *           find the end (see parser.c)
+ *   Return: just past the ')' or '`' that ends it, or end if there is none
+ *     Note: In $(...), parentheses nest and a '\' keeps the char after it
+ *           from counting; the text is taken as it is. In `...`, the first
+ *           '`' without a '\' before it ends it, and a '\' before a '`',
+ *           '$' or '\' is dropped, as in sh.
+ */
+char * cs_scan(char * cp, char * end, int quote, FLEXSTR * cmd)
+{
+    char *start = cp;
+    int depth = 1;
+
+    if (quote == ')')
+    {
+        for ( ; cp < end; cp++)
+        {
+            if (*cp == '\\' && cp + 1 < end)
+                cp++;
+            else if (*cp == '(')
+                depth++;
+            else if (*cp == ')' && --depth == 0)
+                break;
+        }
+        if (cmd != NULL)
+            fs_addnstr(cmd, start, cp - start);
+    }
+    else
+    {
+        for ( ; cp < end && *cp != '`'; cp++)
+        {
+            if (*cp == '\\' && cp + 1 < end &&
+                (cp[1] == '`' || cp[1] == '$' || cp[1] == '\\'))
+                cp++;
+            if (cmd != NULL)
+                fs_addch(cmd, *cp);
+        }
+    }
+    return (cp < end ? cp + 1 : end);
+}
+
+/*
+ *  cs_run()
+ *  Purpose: Run the command of a substitution and capture what it prints
+ *    Input: cmd, len, the command (need not be '\0'-terminated)
+ *   Return: the output, '\0'-terminated, without the newlines at the end.
+ *           It is only good until the next call.
+ */
+char * cs_run(char * cmd, size_t len)
+{
+    struct ar_mark mark;
+    char **args;
+    int rv = 0;
+
+    ar_mark(&mark);
+    args = lex_line(cmd, len);                  // may run inner ones
+
+    if (!out_ready)
+    {
+        fs_init(&out, CS_CHUNK);
+        out_ready = 1;
+    }
+    out.fs_used = 0;                            // keep the space
+
+    if (args[0] == NULL)
+        ;
+    else if (lx_hasops(args))                   // '|', '&', '&&' or '||'
+        rv = run_forked(args);
+    else if (!is_builtin_cmd(args))
+        rv = run_program(args);
+    else if (!is_pure(args) || run_pure(args, &rv) == -1)
+        rv = run_forked(args);
+    ar_release(&mark);
+
+    while (out.fs_used > 0 && fs_data(&out)[out.fs_used - 1] == '\n')
+        out.fs_used--;
+    *fs_room(&out, 1) = '\0';                   // not counted in fs_used
+    set_exit(rv);
+    ran = 1;                                    // after its own lex_line()
+    return fs_data(&out);
+}
+
+/*
+ *  cs_begin()
+ *  Purpose: Note that a new command line is about to be expanded
+ *     Note: lex_line() and tm_expand() call it before they start.
+ */
+void cs_begin()
+{
+    ran = 0;
+}
+
+/*
+ *  cs_ran()
+ *  Purpose: Tell whether a substitution was run while the current
+ *           command line was expanded
+ *   Return: 1 if one was (its status is in $?), 0 if not
+ */
+int cs_ran()
+{
+    return ran;
+}
+
+/*
+ *  is_pure()
+ *  Purpose: Tell whether a command is a builtin that can run in the shell
+ *           without changing anything in it
+ */
+int is_pure(char ** args)
+{
+    struct command *cp = cmd_lookup(args[0], strlen(args[0]));
+
+    return (cp != NULL && cp->cm_run != NULL && cp->cm_pure);
+}
+
+/*
+ *  run_program()
+ *  Purpose: Run a program with its output going into the buffer
+ *   Return: its exit status (127 if it is not found)
+ */
+int run_program(char ** args)
+{
+    int fds[SP_NFDS] = { -1, -1, -1 };
+    int p[2], rv;
+    pid_t pid;
+
+    if (pipe2(p, O_CLOEXEC) == -1)
+    {
+        perror("pipe");
+        return 1;
+    }
+    fds[SP_OUT] = p[1];
+    pid = start_command(args, fds, &rv);
+    close(p[1]);                                // so read_all() sees EOF
+    read_all(p[0]);
+    close(p[0]);
+
+    return (pid == -1 ? rv : wait_command(pid));
+}
+
+/*
+ *  run_pure()
+ *  Purpose: Run a pure builtin in the shell with its output going into
+ *           the buffer
+ *    Input: args, the command
+ *           rvp, where to store its status
+ *   Return: 0 if it was run, -1 if there was no memfd to run it with
+ *     Note: A child forked since the memfd was made (a parallel loop's
+ *           pass, say) shares it with the shell, so it makes its own.
+ */
+int run_pure(char ** args, int * rvp)
+{
+    char *dst;
+    off_t size, off;
+    ssize_t n;
+    int saved;
+
+    if (mfd_pid != getpid())
+    {
+        if (mfd != -1)
+            close(mfd);
+        mfd = make_memfd();
+        mfd_pid = getpid();
+    }
+    if (mfd == -1 || (saved = dup(1)) == -1)
+        return -1;
+
+    fflush(stdout);
+    dup2(mfd, 1);
+    is_builtin(args, rvp);
+    fflush(stdout);
+    dup2(saved, 1);
+    close(saved);
+
+    size = lseek(mfd, 0, SEEK_CUR);
+    dst = fs_room(&out, size);
+    for (off = 0; off < size; off += n)
+        if ((n = pread(mfd, dst + off, size - off, off)) <= 0)
+            break;
+    out.fs_used += off;
+
+    if (ftruncate(mfd, 0) == 0)                 // empty for next time
+        lseek(mfd, 0, SEEK_SET);
+    return 0;
+}
+
+/*
+ *  run_forked()
+ *  Purpose: Run any command in a child of the shell, with its output
+ *           going into the buffer
+ *   Return: its exit status (2 for a syntax error)
+ */
+int run_forked(char ** args)
+{
+    int p[2], rv;
+    pid_t pid;
+
+    if (pipe2(p, O_CLOEXEC) == -1)
+    {
+        perror("pipe");
+        return 1;
+    }
+    fflush(stdout);                             // or the child prints it again
+    if ((pid = fork()) == 0)
+    {
+        jobs_clear();                           // the shell's, not ours
+        dup2(p[1], 1);
+        close(p[0]);
+        close(p[1]);
+        rv = process(args);
+        shell_exit(rv == -1 ? 2 : rv);          // not exit(): stdin is shared
+    }
+    close(p[1]);
+    if (pid == -1)
+    {
+        perror("fork");
+        close(p[0]);
+        return 1;
+    }
+    read_all(p[0]);
+    close(p[0]);
+    return wait_command(pid);
+}
+
+/*
+ *  read_all()
+ *  Purpose: Read from fd until EOF, into the buffer
+ *     Note: Each read() fills all the room the buffer has, so a big output
+ *           takes few calls, and the room doubles when it is used up.
+ */
+void read_all(int fd)
+{
+    char *dst;
+    ssize_t n;
+
+    for (;;)
+    {
+        dst = fs_room(&out, CS_CHUNK);
+        n = read(fd, dst, out.fs_space - out.fs_used);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        out.fs_used += n;
+    }
+}
@@ -0,0 +1,19 @@
+/*
+ * ==========================
+ *   FILE: ./cmdsub.h
+ * ==========================
+ * Purpose: Header file for cmdsub.c
+ */
+
+#ifndef	CMDSUB_H
+#define	CMDSUB_H
+
+#include    <stddef.h>
+#include    "flexstr.h"
+
+char * cs_scan(char *cp, char *end, int quote, FLEXSTR *cmd);
+char * cs_run(char *cmd, size_t len);
+void cs_begin();
+int cs_ran();
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ * ==========================
+ *   FILE: ./cmdtable.c
+ * ==========================
+ * Purpose: Tell in one lookup whether a word is a keyword or a builtin.
+ *
+ * Outline: Every keyword the parser knows and every builtin command is one
+ * line in commands[] below; a new builtin is added there and nowhere else.
+ * A builtin marked pure only prints and sets a status, so $(...) can run
+ * it without a child (see cmdsub.c).
+ * parser.c looks up the first word of each line to classify it, and
+ * builtin.c looks up args[0] of each command to find the function that
+ * runs it, so neither goes down a list of strcmp()s.
+ *
+ * The lookup is a small hash table of indexes into commands[], made the
+ * first time it is used. The hash is the word's length and its first and
+ * last bytes, which are already at hand, so finding a word (or finding it
+ * is not there) costs a few adds and, nearly always, one memcmp().
+ *
+ * interface:
+ *      cmd_lookup(word, len)   -- the keyword or builtin named word, or NULL
+ */
+
+/* INCLUDES */
+#include    <string.h>
+#include    "builtin.h"
+#include    "utilities.h"
+#include    "cmdtable.h"
+
+/* CONSTANTS */
+#define NSLOTS      64              // power of 2, over twice the names
+
+/* FILE-SCOPE VARIABLES */
+static struct command commands[] = {
+    /* keywords */
+    { "if",     KW_IF,      NULL,         0 },
+    { "then",   KW_THEN,    NULL,         0 },
+    { "else",   KW_ELSE,    NULL,         0 },
+    { "fi",     KW_FI,      NULL,         0 },
+    { "for",    KW_FOR,     NULL,         0 },
+    { "do",     KW_DO,      NULL,         0 },
+    { "done",   KW_DONE,    NULL,         0 },
+    { "while",  KW_WHILE,   NULL,         0 },
+    { "until",  KW_UNTIL,   NULL,         0 },
+
+    /* builtins (builtin.c) */
+    { "exit",   KW_NONE,    is_exit,      0 },
+    { "set",    KW_NONE,    is_list_vars, 0 },
+    { "export", KW_NONE,    is_export,    0 },
+    { "cd",     KW_NONE,    is_cd,        0 },
+    { "read",   KW_NONE,    is_read,      0 },
+    { "hash",   KW_NONE,    is_hash,      0 },
+    { "wait",   KW_NONE,    is_wait,      0 },
+
+    /* builtins (utilities.c) */
+    { "echo",   KW_NONE,    is_echo,      1 },
+    { "test",   KW_NONE,    is_test,      1 },
+    { "[",      KW_NONE,    is_test,      1 },
+    { "true",   KW_NONE,    is_true,      1 },
+    { "false",  KW_NONE,    is_false,     1 },
+    { "printf", KW_NONE,    is_printf,    1 },
+    { NULL,     KW_NONE,    NULL,         0 }
+};
+
+static unsigned char slots[NSLOTS];     // index+1 into commands[], 0 if free
+static unsigned char lens[sizeof(commands) / sizeof(commands[0])];
+static int ready = 0;
+
+/* INTERNAL FUNCTIONS */
+static void make_table();
+static unsigned hash(char *, size_t);
+
+/*
+ *  cmd_lookup()
+ *  Purpose: Find the keyword or builtin a word names
+ *    Input: word, len, the word (it need not be '\0'-terminated)
+ *   Return: its entry in the table, or NULL if it is neither
+ */
+struct command * cmd_lookup(char * word, size_t len)
+{
+    unsigned h;
+    int i;
+
+    if (!ready)
+        make_table();
+    if (len == 0)
+        return NULL;
+
+    for (h = hash(word, len); (i = slots[h]) != 0; h = (h + 1) & (NSLOTS - 1))
+        if (lens[i - 1] == len && memcmp(commands[i - 1].cm_name, word, len) == 0)
+            return &commands[i - 1];
+    return NULL;
+}
+
+/*
+ *  make_table()
+ *  Purpose: Put every name in commands[] into the hash table
+ */
+void make_table()
+{
+    unsigned h;
+    int i;
+
+    for (i = 0; commands[i].cm_name != NULL; i++)
+    {
+        lens[i] = strlen(commands[i].cm_name);
+        h = hash(commands[i].cm_name, lens[i]);
+        while (slots[h] != 0)
+            h = (h + 1) & (NSLOTS - 1);
+        slots[h] = i + 1;
+    }
+    ready = 1;
+}
+
+/*
+ *  hash()
+ *  Purpose: Where a word starts looking in the table
+ */
+unsigned hash(char * word, size_t len)
+{
+    return ((unsigned char) word[0] * 7 + (unsigned char) word[len - 1] * 3
+            + len) & (NSLOTS - 1);
+}
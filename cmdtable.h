@@ -0,0 +1,30 @@
+/*
+ * ==========================
+ *   FILE: ./cmdtable.h
+ * ==========================
+ * Purpose: Header file for cmdtable.c
+ */
+
+#ifndef	CMDTABLE_H
+#define	CMDTABLE_H
+
+#include    <stddef.h>
+
+/* LINE CLASSES (parser.c): the first three are not words in the table */
+enum keywords { KW_EOF, KW_BLANK, KW_NONE,
+                KW_IF, KW_THEN, KW_ELSE, KW_FI,
+                KW_FOR, KW_DO, KW_DONE,
+                KW_WHILE, KW_UNTIL };
+
+/* one name the shell knows: a keyword or a builtin */
+struct command {
+    char *  cm_name;
+    int     cm_kw;                      // its keyword, or KW_NONE
+    int  (* cm_run)(char **, int *);    // a builtin: runs it; else NULL
+    int     cm_pure;                    // a builtin that changes nothing in
+                                        //  the shell (see cmdsub.c)
+};
+
+struct command * cmd_lookup(char *word, size_t len);
+
+#endif
@@ -2,379 +2,370 @@
  * ==========================
  *   FILE: ./controlflow.c
  * ==========================
- * Purpose: Handle if-block and for-loop control syntax.
+ * Purpose: Run if-blocks and loops from the tree built by parser.c.
  *
- * "if" processing is done with two state variables
- *    if_state and if_result
+ * Originally, "if" processing was done with two state variables (if_state
+ * and if_result) that were updated as each line went by, and for-loops
+ * were loaded into a file-scope struct and re-read from copies each time
+ * they ran. Now the whole construct is parsed first (see parser.c), so
+ * running it is a walk over the tree: the condition of an if decides
+ * which list runs, a for-loop runs its body once per value, and a while
+ * (until) loop runs its body for as long as its condition succeeds
+ * (fails). Blocks can be nested inside each other to any depth.
  *
- *  Else block handling for if/then/fi control was added for the assignment.
- *  A for loop data structure and several additional helper functions were
- *  also added. For existing functions that were modified, see in-line
- *  comments for the changes. For new functions, please reference header
- *  comments above the function.
+ * Nothing in a node but its first word (read by the parser) is looked at
+ * until the node runs, so the lines of a branch that is not taken cost
+ * nothing more. A line that runs a second time is in a loop and will
+ * likely run again, so then it is compiled into a template (see
+ * template.c): later passes just fill in the variables instead of calling
+ * lex_line() on the text again. Lines in a loop that are never reached,
+ * like a large else-part that is not taken, are never compiled. A line is
+ * also only cut up into an and-or list ("a && b || c", see split_andor()
+ * in parser.c) when it first runs; a command in the list that the status
+ * says to skip is not substituted, and only the externals that are
+ * reached fork; a builtin runs in the shell.
+ *
+ * A loop whose "do" line says "-j N" runs up to N passes at once, each in
+ * a forked copy of the shell with its own value of the loop variable (see
+ * exec_for_par()). What a pass prints is held in a memfd until every pass
+ * before it has been printed, so the output comes out in the same order
+ * as from a plain loop. As with '&', a pass cannot change the shell's
+ * variables or directory.
+ *
+ * The exit status ($?) follows 'dash': an if-block leaves the status of
+ * the last command run in the chosen part (0 if none ran), a loop the
+ * status of the last command of its last pass (0 if it never ran; the
+ * condition of a while loop does not count). A
+ * parallel loop leaves the status of the first pass (in value order) that
+ * failed, or 0 if none did.
  */
- 
+
 /* INCLUDES */
 #include    <stdio.h>
 #include    <string.h>
-#include    <stdbool.h>
 #include    <stdlib.h>
+#include    <unistd.h>
+#include    <signal.h>
+#include    <sys/wait.h>
 #include    "smsh.h"
 #include    "controlflow.h"
 #include    "splitline.h"
-#include    "process.h"
 #include    "builtin.h"
 #include    "flexstr.h"
 #include    "varlib.h"
+#include    "parser.h"
+#include    "template.h"
+#include    "lexer.h"
+#include    "jobs.h"
+#include    "process.h"
+#include    "pipeline.h"
+#include    "arena.h"
 
-/* FOR LOOP STRUCTURE */
-struct for_loop {
-    FLEXSTR varname;        // variable name
-    FLEXLIST varvalues;     // list of values after 'in'
-    FLEXLIST commands;      // list of commands between 'do' and 'done'
-};
-
-static struct for_loop fl;  // file-scope struct to store a for loop
-
-/* CONTROL STATE VARIABLES */
-enum states   { NEUTRAL, WANT_THEN, THEN_BLOCK, ELSE_BLOCK,
-                WANT_DO, WANT_DONE };
-enum results  { SUCCESS, FAIL };
+#ifdef __linux__
+#include    <sys/sendfile.h>
+#endif
 
-/* FILE-SCOPE VARIABLES */
-static int for_state = NEUTRAL;
-static int if_state  = NEUTRAL;
-static int if_result = SUCCESS;
-static int last_stat = 0;
+/* one pass of a parallel loop */
+struct pass {
+    pid_t   ps_pid;             // the worker, -1 once it is reaped
+    int     ps_out;             // memfd holding what it printed
+    int     ps_status;          // its exit status
+};
 
 /* INTERNAL FUNCTIONS */
-static int syn_err(char *);
-static int init_for_loop(char **);
-static void load_for_varname(char *);
-static void load_for_varvalues(char **);
+static void exec_cmd(struct node *);
+static void exec_andor(struct node *);
+static void exec_if(struct node *);
+static void exec_for(struct node *);
+static void exec_while(struct node *);
+static void exec_for_par(struct node *, char **, int);
+static pid_t start_pass(struct node *, char *, int);
+static void copy_out(int);
+static int use_template(struct node *);
 
-int ok_to_execute()
 /*
- * purpose: determine the shell should execute a command
- * returns: 1 for yes, 0 for no
- * details: if in THEN_BLOCK and if_result was SUCCESS then yes
- *          if in THEN_BLOCK and if_result was FAIL    then no
- *          if in WANT_THEN  then syntax error (sh is different)
- *   notes: Copied from starter-code for assignment 5. Code added to handle
- *          else blocks.
+ *  exec_list()
+ *  Purpose: Run each node of a list in turn
+ *   Return: None; $? is updated as commands run
  */
+void exec_list(struct node * list)
 {
-    int rv = 1;     /* default is positive */
-
-    if ( if_state == WANT_THEN ){
-        syn_err("then expected");
-        rv = 0;
+    for ( ; list != NULL; list = list->n_next)
+    {
+        if (list->n_type == N_CMD)
+            exec_cmd(list);
+        else if (list->n_type == N_IF)
+            exec_if(list);
+        else if (list->n_type == N_FOR)
+            exec_for(list);
+        else if (list->n_type == N_WHILE || list->n_type == N_UNTIL)
+            exec_while(list);
+        else
+            fatal("internal error processing:", "unknown node", 2);
     }
-    else if ( if_state == THEN_BLOCK && if_result == SUCCESS )
-        rv = 1;
-    else if ( if_state == THEN_BLOCK && if_result == FAIL )
-        rv = 0;
-    else if ( if_state == ELSE_BLOCK && if_result == SUCCESS )  // added code
-        rv = 0;
-    else if ( if_state == ELSE_BLOCK && if_result == FAIL )     // added code
-        rv = 1;
-    return rv;
 }
 
+/*
+ *  exec_cmd()
+ *  Purpose: Run the command of a node, from its template if it has one
+ */
+void exec_cmd(struct node * n)
+{
+    if (!n->n_split && split_andor(n) == -1)
+        return;                             // syntax error: $? is 2
+    if (n->n_andor != NULL)
+        exec_andor(n->n_andor);
+    else if (use_template(n))
+        run_args(tm_expand(n->n_tmpl));
+    else
+        run_command(n->n_text, n->n_len);
+}
 
-
-int is_control_command(char *s)
 /*
- * purpose: boolean to report if the command is a shell control command
- * returns: 0 or 1
- *   notes: Copied from starter-code for assignment 5. Code added to handle
- *          else blocks.
+ *  exec_andor()
+ *  Purpose: Run the commands of an and-or list, each one only if $? so
+ *           far lets it: after && if it is 0, after || if it is not
+ *     Note: One that is skipped leaves $? as it was, as in sh.
  */
+void exec_andor(struct node * cmd)
 {
-    return (strcmp(s, "if") == 0 ||
-            strcmp(s, "then") == 0 ||
-            strcmp(s, "else") == 0 ||
-            strcmp(s, "fi") == 0);
+    exec_cmd(cmd);
+    for (cmd = cmd->n_next; cmd != NULL; cmd = cmd->n_next)
+        if ((cmd->n_op == OP_AND) == (get_exit() == 0))
+            exec_cmd(cmd);
 }
 
 /*
- *  is_for_loop()
- *  Purpose: boolean to report if the command is a for loop command
- *   Return: 0 or 1
- *     Note: This function mimics the is_control_command() included in the
- *           starter code; just with the for loop keywords.
+ *  exec_if()
+ *  Purpose: Run the condition, then the then-part if it succeeded or the
+ *           else-part (if any) if it failed
  */
-int is_for_loop(char *s)
+void exec_if(struct node * n)
 {
-    return (strcmp(s, "for") == 0 ||
-            strcmp(s, "do") == 0 ||
-            strcmp(s, "done") == 0);
+    struct node *part;
+
+    exec_cmd(n);                            // sets $?
+    part = (get_exit() == 0 ? n->n_body : n->n_else);
+
+    if (part == NULL)                       // nothing to run: status is 0
+        set_exit(0);
+    exec_list(part);
 }
 
 /*
- *  load_for_loop()
- *  Purpose: Once a for loop has been started, load_for_loop() is called until
- *           'done' to populate for loop struct.
- *   Return: true, when done loading for loop
- *           false, otherwise
+ *  exec_for()
+ *  Purpose: Substitute and split the values, then run the body once for
+ *           each value with the loop variable set to it
+ *     Note: Values are substituted when the loop starts, so a loop nested
+ *           in another one sees the current value of the outer variable.
+ *           The values of a nested loop come from its template once it
+ *           has one; they stay put while it runs, since only this node
+ *           expands that template.
  */
-int load_for_loop(char *args)
-{   
-    char **arglist = splitline(args);
-    
-    if(arglist == NULL || arglist[0] == NULL)   // check if we have args
-        return false;                           // we don't
-    
-    if(for_state == WANT_DO)
+void exec_for(struct node * n)
+{
+    struct ar_mark mark;
+    char **vars, **vp;
+
+    ar_mark(&mark);
+    if (use_template(n))                    // load in varvalues
+        vars = tm_expand(n->n_tmpl);
+    else
+        vars = lex_line(n->n_text, n->n_len);
+
+    set_exit(0);                            // if the loop never runs
+
+    if (n->n_jobs != 0 && vars[0] != NULL)
     {
-        if(strcmp(arglist[0], "do") == 0)
-            for_state = WANT_DONE;
-        else
-            return syn_err("word unexpected (expecting \"do\")");
+        exec_for_par(n, vars, n->n_jobs);
+        ar_release(&mark);
+        return;
     }
-    else if (for_state == WANT_DONE)
+
+    for (vp = vars; *vp; vp++)              // for each varvalue
     {
-        if(strcmp(arglist[0], "done") == 0) // reached the end?
+        if (VLstore(n->n_name, *vp) == 1)   // set current var for sub
         {
-            for_state = NEUTRAL;            // reset state
-            return true;                    // done loading
+            complain("Problem updating the for variable. \n");
+            set_exit(2);
+            break;
         }
 
-        fl_append(&fl.commands, args);      // not a 'done', load raw command
+        exec_list(n->n_body);               // go through cmds for each var
     }
-    else
-        fatal("internal error processing:", arglist[0], 2);
-    
-    return false;
+
+    ar_release(&mark);                      // the values, if lex_line()'s
 }
 
 /*
- *  do_for_loop()
- *  Purpose: Process "for", "do", "done" - start loading for loop at start;
- *           display errors for out-of-order commands
- *   Return: 0 if ok, -1 (or fatal) for syntax error
+ *  exec_while()
+ *  Purpose: Run the condition, and the body after it each time it
+ *           succeeds (while) or fails (until)
+ *     Note: The condition and the body are nodes like any others, so from
+ *           the second pass on they run from their templates, and a
+ *           builtin condition ('test', '[', 'read') runs in the shell.
  */
-int do_for_loop(char **args)
+void exec_while(struct node * n)
 {
-    char *cmd = args[0];
-    int rv = -1;
-    
-    if (strcmp(cmd, "for") == 0)
-    {
-        if (for_state != NEUTRAL)
-            rv = syn_err("for unexpected");
-        else 
-        {
-            rv = init_for_loop(args);       // start loading for loop
-            for_state = WANT_DO;
-        }
-    }
-    // check for out-of-sequence control words
-    else if (strcmp(cmd, "do") == 0)
-    {
-        if (for_state != WANT_DO)
-            rv = syn_err("do unexpected");
-    }
-    else if (strcmp(cmd, "done") == 0)
+    int status = 0;                         // if the body never runs
+
+    for (;;)
     {
-        if (for_state != WANT_DONE)
-            rv = syn_err("done unexpected");
+        exec_cmd(n);                        // the condition sets $?
+        if ((get_exit() == 0) != (n->n_type == N_WHILE))
+            break;
+        exec_list(n->n_body);
+        status = get_exit();
     }
-    else
-        fatal("internal error processing:", cmd, 2);
-        
-    return rv;
+    set_exit(status);
 }
 
-int do_control_command(char **args)
 /*
- * purpose: Process "if", "then", "else", "fi" - change state or detect error
- * returns: 0 if ok, -1 for syntax error
- *   notes: I would have put returns all over the place, Barry says "no"
- *   notes: Copied from starter-code for assignment 5. Code added to handle
- *          else blocks.
+ *  exec_for_par()
+ *  Purpose: Run the passes of a loop at the same time, at most njobs of
+ *           them at once, and print their output in order
+ *    Input: n, the loop
+ *           vars, the values
+ *           njobs, the limit, or FOR_NCPUS
+ *   Method: Start passes until njobs are running. Then sleep until a child
+ *           ends, reap any pass that is done, print the output of the
+ *           passes at the front that are all done, and start more. SIGCHLD
+ *           is blocked except in sigsuspend(), so none can be missed.
+ *     Note: Passes are reaped by pid, like everything else (see jobs.c).
  */
+void exec_for_par(struct node * n, char ** vars, int njobs)
 {
-    char    *cmd = args[0];
-    int rv = -1;
-
-    if( strcmp(cmd,"if")==0 ){
-        if ( if_state != NEUTRAL )
-            rv = syn_err("if unexpected");
-        else {
-            last_stat = process(args+1);
-            if_result = (last_stat == 0 ? SUCCESS : FAIL );
-            if_state = WANT_THEN;
-            rv = 0;
-        }
-    }
-    else if ( strcmp(cmd,"then")==0 ){
-        if ( if_state != WANT_THEN )
-            rv = syn_err("then unexpected");
-        else {
-            if_state = THEN_BLOCK;
-            rv = 0;
-        }
-    }
-    // added for the assignment
-    else if ( strcmp(cmd, "else") == 0) {
-        if( if_state != THEN_BLOCK )
-            rv = syn_err("else unexpected");
-        else {
-            if_state = ELSE_BLOCK;
-            rv = 0;
-        }
-    }
-    // modified for the assignment
-    else if ( strcmp(cmd,"fi")==0 ){
-        if ( if_state == THEN_BLOCK || if_state == ELSE_BLOCK) {
-            if_state = NEUTRAL;
-            rv = 0;
-        }
-        else {
-            rv = syn_err("fi unexpected");
-        }
-    }
-    else 
-        fatal("internal error processing:", cmd, 2);
-    return rv;
-}
+    struct pass *ps;
+    sigset_t chld, old;
+    int nvals, next = 0, head = 0, running = 0, status = 0;
+    int i, info, reaped;
 
+    for (nvals = 0; vars[nvals] != NULL; nvals++)
+        ;
+    if (njobs == FOR_NCPUS && (njobs = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+        njobs = 1;
+    ps = emalloc(nvals * sizeof(struct pass));
 
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld, &old);
+    fflush(stdout);                         // or each worker prints it too
 
-/*
- *  init_for_loop()
- *  Purpose: Check the first line of for loop syntax, and initialize struct
- *   Return: 0 on success, -1 (or fatal) on syntax error
- */
-int init_for_loop(char **args)
-{   
-    args++;                             //strip the 'for'
-    
-    if ( okname(*args) )                // valid varname
+    while (head < nvals)
     {
-        load_for_varname(*args++);      // store in struct, strip from args
-        
-        if(strcmp(*args, "in") == 0)    // validate "in"
+        while (running < njobs && next < nvals)
         {
-            load_for_varvalues(++args); // load any args after that
-            for_state = WANT_DO;        // change state
+            ps[next].ps_out = make_memfd();
+            ps[next].ps_pid = start_pass(n, vars[next], ps[next].ps_out);
+            ps[next].ps_status = 1;         // if it could not be started
+            if (ps[next].ps_pid != -1)
+                running++;
+            next++;
         }
-        else
+
+        reaped = 0;
+        for (i = head; i < next; i++)
+            if (ps[i].ps_pid != -1 && waitpid(ps[i].ps_pid, &info, WNOHANG) > 0)
+            {
+                ps[i].ps_status = child_status(info);
+                ps[i].ps_pid = -1;
+                running--;
+                reaped = 1;
+            }
+
+        for ( ; head < next && ps[head].ps_pid == -1; head++)
         {
-            return syn_err("word unexpected (expecting \"in\")");
+            if (ps[head].ps_out != -1)      // print it in its turn
+            {
+                copy_out(ps[head].ps_out);
+                close(ps[head].ps_out);
+            }
+            if (status == 0)
+                status = ps[head].ps_status;
         }
+
+        if (!reaped && head < nvals && (running == njobs || next == nvals))
+            sigsuspend(&old);               // nothing to do until one ends
     }
-    else
-    {
-        syn_err("Bad for loop variable");
-    }
-    
-    return 0;
-}
 
-/*
- *  is_parsing_for()
- *  Purpose: Check if shell is currently reading in a for_loop struct
- *   Return: 1 if reading in a for_loop, 0 if not
- */
-int is_parsing_for()
-{
-    return for_state != NEUTRAL;
-}
+    sigprocmask(SIG_SETMASK, &old, NULL);
+    free(ps);
 
-/*
- *  safe_to_exit()
- *  Purpose: On EOF, check if it is safe for the shell to exit.
- *   Return: 0 when okay to exit, -1 (or fatal) from syn_err otherwise
- *     Note: If the shell is currently processing an if-block or a for loop,
- *           the shell will output an error message, and reset the state of
- *           the control-flow, a la 'dash'. set_exit() is called to ensure
- *           exit status of 2 for syntax errors.
- */
-int safe_to_exit()
-{
-    if (if_state != NEUTRAL || for_state != NEUTRAL)
-    {
-        set_exit(2);
-        return syn_err("end of file unexpected");
-    }
-    
-    return 0;
+    VLstore(n->n_name, vars[nvals - 1]);    // as a plain loop leaves it
+    set_exit(status);
 }
 
-int syn_err(char *msg)
-/* purpose: handles syntax errors in control structures
- * details: resets state to NEUTRAL
- * returns: -1 in interactive mode. Should call fatal in scripts
+/*
+ *  start_pass()
+ *  Purpose: Fork a worker to run the loop body once
+ *    Input: n, the loop
+ *           val, the value of the loop variable for this pass
+ *           out, the memfd for its output, or -1 to print it right away
+ *   Return: the pid of the worker, or -1 if there is none
  */
+pid_t start_pass(struct node * n, char * val, int out)
 {
-    if(get_mode() == SCRIPTED)
-        fatal("syntax error: ", msg, 2);
-        
-    if_state = NEUTRAL;
-    for_state = NEUTRAL;
-    fprintf(stderr,"syntax error: %s\n", msg);
-
-    return -1;
-}
+    sigset_t none;
+    pid_t pid;
 
+    if ((pid = fork()) == -1)
+        perror("fork");
+    if (pid != 0)
+        return pid;
 
-/*
- *  load_for_varname()
- *  Purpose: Helper function to initialize varname field in for loop struct
- *    Input: str, the value of varname
- */
-void load_for_varname(char * str)
-{
-    FLEXSTR name;
-    fs_init(&name, 0);
-    fs_addstr(&name, str);
-    fs_addch(&name, '\0');
-    fl.varname = name;
-}
+    sigemptyset(&none);                     // the worker is on its own
+    sigprocmask(SIG_SETMASK, &none, NULL);
+    jobs_clear();
+    if (out != -1)
+        dup2(out, 1);
 
-/*
- *  load_for_varvalues()
- *  Purpose: Helper function to initialize varvalues field in for loop struct
- *    Input: args, array of variable values
- */
-void load_for_varvalues(char **args)
-{
-    FLEXLIST vars;
-    fl_init(&vars, 0);
-    while(*args)
+    if (VLstore(n->n_name, val) == 1)
     {
-        fl_append(&vars, *args);
-        args++;
+        fprintf(stderr, "Problem updating the for variable. \n");
+        _exit(2);
     }
-    
-    fl.varvalues = vars;
+    exec_list(n->n_body);
+    fflush(stdout);
+    _exit(get_exit());                      // not exit(): stdin is shared
 }
 
 /*
- *  get_for_commands()
- *  Purpose: getter to access for struct info in main()
+ *  copy_out()
+ *  Purpose: Print what a pass wrote into its memfd
+ *     Note: sendfile() hands the pages to stdout without a copy in the
+ *           shell; where it cannot (not Linux, or stdout is odd), read and
+ *           write.
  */
-char ** get_for_commands()
+void copy_out(int fd)
 {
-    return fl_getlist(&fl.commands);
-}
+    char buf[BUFSIZ];
+    off_t off = 0, size = lseek(fd, 0, SEEK_END);
+    ssize_t n;
 
-/*
- *  get_for_vars()
- *  Purpose: getter to access for struct info in main()
- */
-char ** get_for_vars()
-{
-    return fl_getlist(&fl.varvalues);
+#ifdef __linux__
+    while (off < size && (n = sendfile(1, fd, &off, size - off)) > 0)
+        ;
+#endif
+    while (off < size && (n = pread(fd, buf, sizeof(buf), off)) > 0)
+    {
+        if (write(1, buf, n) != n)
+            break;
+        off += n;
+    }
 }
 
 /*
- *  get_for_name()
- *  Purpose: getter to access for struct info in main()
+ *  use_template()
+ *  Purpose: Decide how to substitute a node's text this time it runs
+ *   Return: 1 to expand its template (compiled now, on its second run),
+ *           0 to call lex_line() on the text (its first run)
  */
-char * get_for_name()
+int use_template(struct node * n)
 {
-    return fs_getstr(&fl.varname);
+    if (n->n_tmpl != NULL)
+        return 1;
+    if (n->n_runs++ == 0)
+        return 0;
+    n->n_tmpl = tm_compile(n->n_text, n->n_len);
+    return 1;
 }
@@ -4,22 +4,13 @@
  * ==========================
  * Purpose: Header file for controlflow.c
  */
- 
-// From starter code
-int is_control_command(char *);
-int do_control_command(char **);
-int ok_to_execute();
 
-// To call in process.c
-int is_for_loop(char *s);
-int do_for_loop(char **args);
+#ifndef	CONTROLFLOW_H
+#define	CONTROLFLOW_H
+
+#include    "parser.h"
 
 // To call in smsh.c
-int load_for_loop(char *args);
-int is_parsing_for();
-int safe_to_exit();
+void exec_list(struct node *list);
 
-// getter functions
-char ** get_for_commands();
-char ** get_for_vars();
-char * get_for_name();
\ No newline at end of file
+#endif
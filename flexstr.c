@@ -20,6 +20,8 @@ void	*erealloc(void *, size_t);
  *
  *	char ** fl_getlist(FLEXLIST *p)	- return deep copy of list (NULL term)
  *	char ** fl_getlistd(FLEXLIST *p)- return the internal array
+ *	char ** fl_steal(FLEXLIST *p)	- hand over the array and its strings
+ *					  (NULL term), leaving p empty
  *	void fl_freelist(char **l)	- free the deep copy of list(NULL term)
  *
  *      a FLEXSTR a string that grows as needed
@@ -27,12 +29,20 @@ void	*erealloc(void *, size_t);
  *	fs_init(FLEXSTR *p,int chunk)
  *	fs_addch(FLEXSTR *p, char c)
  *	fs_addstr(FLEXSTR *p, char *str)
+ *	fs_addnstr(FLEXSTR *p, char *str, int n) - add n chars at once
  *	fs_free(FLEXSTR *p)		- frees storage, resets counters
  *
  *	char *fs_getstr(FLEXSTR *p)	- rets copy of str, caller free()s it
  *	char *fs_getstrd(FLEXSTR *p)	- returns the internal string
+ *	char *fs_detach(FLEXSTR *p, n)	- hands over the string in a malloc()ed
+ *					  block of n bytes, resets the FLEXSTR
+ *	char *fs_room(FLEXSTR *p, n)	- makes room for n more chars and
+ *					  returns where they go (for read())
  *
  *  VERSION 2: 10q to AL for mentioning V1's subtle complexity of memory mgmt
+ *  VERSION 3: FLEXSTR keeps short strings in an inline buffer and grows
+ *	  its heap space geometrically (growing by a fixed CHUNKSIZE made
+ *	  an n-char string cost n/20 reallocs); bulk fs_addnstr()
  *  2019-04-20: added fl_appendd to work with splitline
  *  2019-04-08: fl_getlist: do not call strdup on NULL (bug fix)
  *
@@ -41,6 +51,9 @@ void	*erealloc(void *, size_t);
  *	  REMOVE strdups of the strings.  Let the caller allocate space
  *	  and let the fl_free function release them all unless the 
  *	  caller wants to.  Adding the strdups makes things worse.
+ *  DONE: fl_appendd() takes the caller's string, fl_steal() gives the
+ *	  array and strings back without a copy (free with fl_freelist()).
+ *	  fl_getlist() still copies.
  */
 
 
@@ -93,6 +106,8 @@ fl_getlist(FLEXLIST *p)
 	return rv;
 }
 
+static void fl_terminate(FLEXLIST *);
+
 /*
  * returns the actual internal storage (faster, riskier)
  * no sentinel NULL
@@ -103,7 +118,37 @@ fl_getlistd(FLEXLIST *p)
 	return p->fl_list;
 }
 /*
- * free a list returned by fl_getlist()
+ * hand the internal array and the strings in it to the caller, with a
+ * NULL sentinel.  p is left empty; free the array with fl_freelist()
+ */
+char **
+fl_steal(FLEXLIST *p)
+{
+	char	**rv;
+
+	fl_terminate(p);
+	rv = p->fl_list;
+	fl_init(p, p->fl_growby);		/* p no longer owns them */
+	return rv;
+}
+
+/*
+ * put a NULL after the last item, making room for it if needed.
+ * the NULL is not counted, so appends write over it
+ */
+static void
+fl_terminate(FLEXLIST *p)
+{
+	if ( p->fl_nused == p->fl_nslots ){
+		p->fl_nslots += 1;
+		p->fl_list    = erealloc(p->fl_list,
+					 p->fl_nslots * sizeof(char *));
+	}
+	p->fl_list[p->fl_nused] = NULL;
+}
+
+/*
+ * free a list returned by fl_getlist() or fl_steal()
  */
 void fl_freelist(char **list)
 {
@@ -149,11 +194,17 @@ fl_append(FLEXLIST *p, char *str)
  *
  ************************************************************************/
 
+static void fs_grow(FLEXSTR *, int);
+
 void 
 fs_init(FLEXSTR *p, int amt)
+/*
+ * amt is the least heap space to get once the inline buffer is full
+ */
 {
 	p->fs_str = NULL;
-	p->fs_space = p->fs_used = 0;
+	p->fs_space = FS_SMALL;
+	p->fs_used = 0;
 	p->fs_growby = ( amt > 0 ? amt : CHUNKSIZE );
 }
 
@@ -172,24 +223,25 @@ fs_free(FLEXSTR *p)
 char *
 fs_getstrd(FLEXSTR *p)
 {
-/* returns a pointer to the internal storage. faster/riskier than fs_getstr. */
+/* returns a pointer to the internal storage. faster/riskier than fs_getstr.
+ * note: a short string is inside the FLEXSTR itself, so the pointer is
+ * only good as long as p is (and until p changes).
+ */
 
     /* nul-terminate the string before returning it*/
 
     /* First make sure there's room for the '\0' */
     if (p->fs_used == p->fs_space)
-    { /* string is full, add room for one more char */
-        p->fs_str = erealloc(p->fs_str, ++p->fs_space);
-    }
+        fs_grow(p, 1);
 
     /* Add terminating '\0'.  Don't increment fs_used -- the '\0' is not
      * part of the string, and shouldn't be counted if someone wants to
      * continue adding characters to the string later.
      */
-    p->fs_str[p->fs_used] = '\0';
+    fs_data(p)[p->fs_used] = '\0';
 
     /* Now return the (terminated) string. */
-	return p->fs_str;
+	return fs_data(p);
 }
 char *
 fs_getstr(FLEXSTR *p)
@@ -199,6 +251,72 @@ fs_getstr(FLEXSTR *p)
 	return strdup( fs_getstrd(p) );
 }
 
+char *
+fs_detach(FLEXSTR *p, size_t room)
+/*
+ * hand the string over to the caller in a malloc()ed block of at least
+ * room bytes (the chars are not terminated) and reset p to empty.
+ * Saves the copy fs_getstr() makes when the FLEXSTR is done with anyway.
+ */
+{
+	char	*rv;
+
+	if ( room < (size_t) p->fs_used )
+		room = p->fs_used;
+	if ( room == 0 )
+		room = 1;
+
+	if ( p->fs_str == NULL ){		/* still inline: copy out */
+		rv = emalloc(room);
+		memcpy(rv, p->fs_small, p->fs_used);
+	}
+	else					/* already on the heap	*/
+		rv = erealloc(p->fs_str, room);
+
+	fs_init(p, p->fs_growby);
+	return rv;
+}
+
+static void
+fs_grow(FLEXSTR *p, int need)
+/*
+ * make room for need more chars: double the space (at least growby,
+ * at least enough), moving out of the inline buffer the first time
+ */
+{
+	int	want = p->fs_used + need;
+	int	space;
+
+	if ( want <= p->fs_space )
+		return;
+
+	space = 2 * p->fs_space;
+	if ( space < p->fs_growby )
+		space = p->fs_growby;
+	if ( space < want )
+		space = want;
+
+	if ( p->fs_str == NULL ){
+		p->fs_str = emalloc(space);
+		memcpy(p->fs_str, p->fs_small, p->fs_used);
+	}
+	else
+		p->fs_str = erealloc(p->fs_str, space);
+	p->fs_space = space;
+}
+
+char *
+fs_room(FLEXSTR *p, int need)
+/*
+ * make room for at least need more chars and return where they go; the
+ * caller puts them there (read() straight into the string, say) and adds
+ * how many it put to fs_used.  All of fs_space - fs_used is free to fill.
+ */
+{
+	fs_grow(p, need);
+	return fs_data(p) + p->fs_used;
+}
+
 /*
  * append char to flexstring, reallocing the array if needed
  * return 0 for ok dies on error
@@ -207,25 +325,29 @@ fs_getstr(FLEXSTR *p)
 int
 fs_addch(FLEXSTR *p, char c)
 {
-	if ( p->fs_space == 0 ){
-		p->fs_str  = emalloc(p->fs_growby);
-		p->fs_used = 0;
-		p->fs_space= p->fs_growby;
-	}
-	else if ( p->fs_used == p->fs_space ){
-		p->fs_space += p->fs_growby;
-		p->fs_str    = erealloc(p->fs_str, p->fs_space);
-	}
-	p->fs_str[p->fs_used++] = c;
+	if ( p->fs_used == p->fs_space )
+		fs_grow(p, 1);
+	fs_data(p)[p->fs_used++] = c;
 	return 0;
 }
 
+/*
+ * append n chars of s (no '\0' needed) in one copy
+ * return 0 for ok dies on error
+ */
 int
-fs_addstr(FLEXSTR *p, char *s)
+fs_addnstr(FLEXSTR *p, char *s, int n)
 {
-	int	c;
-
-	while( (c = *s++) != '\0' )
-		fs_addch(p, c);
+	if ( n <= 0 )
+		return 0;
+	fs_grow(p, n);
+	memcpy(fs_data(p) + p->fs_used, s, n);
+	p->fs_used += n;
 	return 0;
-}
\ No newline at end of file
+}
+
+int
+fs_addstr(FLEXSTR *p, char *s)
+{
+	return fs_addnstr(p, s, strlen(s));
+}
@@ -1,6 +1,8 @@
 #ifndef	FLEXSTR_H
 #define	FLEXSTR_H
 
+#include	<stddef.h>
+
 /*
  * flexstr.h -- a set of functions for handling flexlists and flexstrings
  *
@@ -12,6 +14,8 @@
  *	fl_appendd(FLEXLIST *p, char *)	- add a str (no copy) to a FLEXLIST
  *					  string passed must be from malloc()
  *	char ** fl_getlist(FLEXLIST *p)	- return array of strings in the list
+ *	char ** fl_steal(FLEXLIST *p)	- same, but no copy: the caller gets
+ *					  the array and strings, p is emptied
  *	fl_free(FLEXLIST *p)		- dispose of all malloced data therein
  *	fl_getcount(FLEXLIST *p)	- return the number of items
  *
@@ -20,6 +24,7 @@
 
 
 #define	CHUNKSIZE	20
+#define	FS_SMALL	64	/* short strings stay inside the FLEXSTR */
 
 struct strlist {
 			int	fl_nslots;
@@ -39,13 +44,21 @@ int fl_appendd(FLEXLIST *p, char *str);
 
 char ** fl_getlist(FLEXLIST *p);
 char ** fl_getlistd(FLEXLIST *p);
+char ** fl_steal(FLEXLIST *p);
 void fl_freelist(char **);
 
+/*
+ * a FLEXSTR starts out using fs_small, its inline buffer, and only
+ * goes to the heap (fs_str) when the string outgrows it; from then on
+ * the heap space doubles each time it fills.  fs_str is NULL while the
+ * inline buffer is in use, so use fs_data() to get at the chars.
+ */
 struct flexstring {
 			int	fs_space;
 			int	fs_used;
 			char	*fs_str;
 			int	fs_growby;
+			char	fs_small[FS_SMALL];
 
 			/* methods here */
 			
@@ -58,12 +71,17 @@ struct flexstring {
 
 typedef struct flexstring FLEXSTR;
 
+#define	fs_data(p)	((p)->fs_str != NULL ? (p)->fs_str : (p)->fs_small)
+
 void fs_init(FLEXSTR *p,int amt);
 void fs_free(FLEXSTR *p);
 char * fs_getstr(FLEXSTR *p);
 char * fs_getstrd(FLEXSTR *p);
 int fs_addch(FLEXSTR *p, char c);
 int fs_addstr(FLEXSTR *p, char *s);
+int fs_addnstr(FLEXSTR *p, char *s, int n);
+char * fs_detach(FLEXSTR *p, size_t room);
+char * fs_room(FLEXSTR *p, int need);
 FLEXSTR *fso_new(int amt);
 
 #endif
\ No newline at end of file
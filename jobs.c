@@ -0,0 +1,253 @@
+/*
+ * ==========================
+ *   FILE: ./jobs.c
+ * ==========================
+ * Purpose: Keep track of the commands running in the background.
+ *
+ * Outline: A command line ending in '&' is started and not waited for;
+ * its pid goes into the job table here. A SIGCHLD handler reaps finished
+ * jobs as they end, so the shell goes on reading commands without ever
+ * blocking on one, and a finished job does not stay a zombie.
+ *
+ * The handler calls waitpid() on the pids in the table only, never
+ * waitpid(-1): execute() and run_pipeline() wait for their own children
+ * by pid, and a handler that reaped any child could take one of those
+ * first. The table is only changed with SIGCHLD blocked, so the handler
+ * never sees it half done.
+ *
+ * A finished job keeps its status in the table until 'wait' asks for it,
+ * as in dash, so "p=$!; ... cmd & wait $p" still gets p's status. So that
+ * a script that starts jobs and never waits cannot grow the table (and
+ * the handler's walk over it) without end, at most MAXDONE finished jobs
+ * are kept: when there are that many, the oldest half of them are dropped.
+ * Jobs still running are never dropped.
+ *
+ * interface:
+ *      jobs_init()           -- set up the SIGCHLD handler
+ *      job_add(pid)          -- a new background job; returns its number
+ *      job_wait(pid, &rv)    -- wait for one job and get its status
+ *      job_waitall()         -- wait for every job
+ *      job_lastpid()         -- pid of the newest job ($!)
+ *      jobs_clear()          -- forget them all (in a subshell)
+ */
+
+/* INCLUDES */
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <errno.h>
+#include    <signal.h>
+#include    <sys/wait.h>
+#include    "splitline.h"
+#include    "process.h"
+#include    "jobs.h"
+
+/* CONSTANTS */
+#define MINJOBS     16
+#define MAXDONE     1024                // finished jobs kept for 'wait'
+
+/* one background job */
+struct job {
+    pid_t                   jb_pid;
+    int                     jb_info;    // wait() status, once it is done
+    volatile sig_atomic_t   jb_done;    // set by the handler
+};
+
+/* FILE-SCOPE VARIABLES */
+static struct job * jobs = NULL;
+static int njobs = 0;
+static int nslots = 0;
+static volatile sig_atomic_t ndone = 0; // how many of them are finished
+static pid_t lastpid = 0;
+
+/* INTERNAL FUNCTIONS */
+static void reap_jobs(int);
+static void block_chld(sigset_t *);
+static void drop_job(int);
+static void drop_done(int);
+
+/*
+ *  jobs_init()
+ *  Purpose: Reap background jobs whenever a child ends
+ *     Note: SA_RESTART, so a read() or waitpid() the shell is in when a
+ *           job ends goes on as if nothing had happened.
+ */
+void jobs_init()
+{
+    struct sigaction sa;
+
+    sa.sa_handler = reap_jobs;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigaction(SIGCHLD, &sa, NULL);
+}
+
+/*
+ *  reap_jobs()
+ *  Purpose: The SIGCHLD handler: collect every job that has finished
+ *     Note: Also called with SIGCHLD blocked, by job_add().
+ */
+void reap_jobs(int sig)
+{
+    int saved = errno;
+    int i, info;
+    pid_t pid;
+
+    for (i = 0; i < njobs; i++)
+    {
+        if (jobs[i].jb_done)
+            continue;
+        pid = waitpid(jobs[i].jb_pid, &info, WNOHANG);
+        if (pid == 0)                           // still running
+            continue;
+        jobs[i].jb_info = (pid == -1 ? -1 : info);
+        jobs[i].jb_done = 1;
+        ndone++;
+    }
+    errno = saved;
+}
+
+/*
+ *  job_add()
+ *  Purpose: Put a new background job in the table
+ *    Input: pid, its process
+ *   Return: its job number (for the "[n] pid" message)
+ *     Note: If the job is already over, no SIGCHLD is left to say so (the
+ *           handler ran before the job was here), so look once now. If
+ *           MAXDONE jobs are over and not waited for, the oldest half of
+ *           them are dropped first.
+ */
+int job_add(pid_t pid)
+{
+    sigset_t old;
+    int num;
+
+    block_chld(&old);
+    if (ndone >= MAXDONE)
+        drop_done(MAXDONE / 2);
+    if (njobs == nslots)
+    {
+        nslots = (nslots == 0 ? MINJOBS : 2 * nslots);
+        jobs = erealloc(jobs, nslots * sizeof(struct job));
+    }
+    jobs[njobs].jb_pid = pid;
+    jobs[njobs].jb_done = 0;
+    num = ++njobs;
+    lastpid = pid;
+    reap_jobs(SIGCHLD);
+    sigprocmask(SIG_SETMASK, &old, NULL);
+    return num;
+}
+
+/*
+ *  job_wait()
+ *  Purpose: Wait for one background job to finish, and forget it
+ *    Input: pid, the job
+ *           resultp, where to store its exit status
+ *   Return: 0 if ok, -1 if pid is not a job of this shell
+ */
+int job_wait(pid_t pid, int * resultp)
+{
+    sigset_t old;
+    int i;
+
+    block_chld(&old);
+    for (i = 0; i < njobs && jobs[i].jb_pid != pid; i++)
+        ;
+    if (i == njobs)
+    {
+        sigprocmask(SIG_SETMASK, &old, NULL);
+        return -1;
+    }
+
+    while (!jobs[i].jb_done)                    // sleep until a child ends
+        sigsuspend(&old);
+
+    *resultp = (jobs[i].jb_info == -1 ? 127 : child_status(jobs[i].jb_info));
+    drop_job(i);
+    ndone--;
+    sigprocmask(SIG_SETMASK, &old, NULL);
+    return 0;
+}
+
+/*
+ *  job_waitall()
+ *  Purpose: Wait for every background job to finish, and forget them all
+ */
+void job_waitall()
+{
+    sigset_t old;
+    int i;
+
+    block_chld(&old);
+    for (i = 0; i < njobs; i++)
+        while (!jobs[i].jb_done)
+            sigsuspend(&old);
+    njobs = ndone = 0;
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+/*
+ *  job_lastpid()
+ *  Purpose: The pid of the most recent background job, for $!
+ *   Return: it, or 0 if none has been started
+ */
+pid_t job_lastpid()
+{
+    return lastpid;
+}
+
+/*
+ *  jobs_clear()
+ *  Purpose: Empty the table, in a child forked to run a background job
+ *           (the parent's jobs are not its children)
+ */
+void jobs_clear()
+{
+    sigset_t old;
+
+    block_chld(&old);
+    njobs = ndone = 0;
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+/*
+ *  block_chld()
+ *  Purpose: Hold off SIGCHLD while the table is used
+ *    Input: old, where to put the signal mask to go back to
+ */
+void block_chld(sigset_t * old)
+{
+    sigset_t chld;
+
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld, old);
+}
+
+/*
+ *  drop_done()
+ *  Purpose: Take the oldest jobs that are over out of the table, until
+ *           only keep of them are left (SIGCHLD must be blocked)
+ */
+void drop_done(int keep)
+{
+    int i, k, drop = ndone - keep;
+
+    for (i = 0, k = 0; i < njobs; i++)
+        if (jobs[i].jb_done && drop > 0)
+            drop--;
+        else
+            jobs[k++] = jobs[i];
+    njobs = k;
+    ndone = keep;
+}
+
+/*
+ *  drop_job()
+ *  Purpose: Take a job out of the table (SIGCHLD must be blocked)
+ */
+void drop_job(int i)
+{
+    for (njobs--; i < njobs; i++)
+        jobs[i] = jobs[i + 1];
+}
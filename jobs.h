@@ -0,0 +1,20 @@
+/*
+ * ==========================
+ *   FILE: ./jobs.h
+ * ==========================
+ * Purpose: Header file for jobs.c
+ */
+
+#ifndef	JOBS_H
+#define	JOBS_H
+
+#include    <sys/types.h>
+
+void jobs_init();
+int job_add(pid_t pid);
+int job_wait(pid_t pid, int *resultp);
+void job_waitall();
+pid_t job_lastpid();
+void jobs_clear();
+
+#endif
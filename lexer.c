@@ -0,0 +1,491 @@
+/*
+ * ==========================
+ *   FILE: ./lexer.c
+ * ==========================
+ * Purpose: Turn a raw command line into an argv in a single pass.
+ *
+ * Outline: A command line used to be scanned twice: varsub() copied it
+ * into a FLEXSTR with the comment cut off and the variables filled in,
+ * then splitline() scanned that copy again for blanks. lex_line() does
+ * both jobs in one walk over the raw line, with the same rules:
+ *      - a '#' after a blank (or at the start) begins a comment
+ *      - '\' takes the next char literally (a blank still splits words)
+ *      - '$' is followed by a variable name, '$$', '$?' or '$!', and the
+ *        value is split at blanks
+ *      - '$(command)' and '`command`' are replaced by what the command
+ *        prints (see cmdsub.c), split the same way
+ *      - neither kind of value is split in an assignment (x=$y at the
+ *        start of a command)
+ *      - '$((expression))' is replaced by its value (see arith.c)
+ *      - blanks separate words
+ *      - '|', '&', '&&' and '||' are operators: each ends the word before
+ *        it and comes back as a pointer into lx_ops[] (a '\|' or '\&' is a
+ *        plain char)
+ * Each word goes straight into a word buffer, '\0'-terminated, with no
+ * intermediate string. When the line is done, the words and the argv
+ * after them are copied into one block in the arena (see arena.c), which
+ * the caller releases when the command is over; the word buffer is kept
+ * for the next line, so a command costs no malloc() once the shell is
+ * warmed up. Runs of plain text between the chars above are found by
+ * ts_plain() (see tokscan.c) and copied in one piece.
+ *
+ * The word builder (the wb_ functions) is also used by template.c to
+ * expand compiled loop bodies, so both paths split words the same way.
+ *
+ * interface:
+ *      lex_line(line, len)          -- substitute and split a command line
+ *      lx_opcode(word)              -- which operator a word is, or -1
+ *      lx_scanop(&cp, end)          -- read the operator at cp
+ *      lx_hasops(args)              -- does an argv have any operator in it?
+ *      wb_init(), wb_reset(), wb_free()
+ *      wb_addtext(), wb_addfield(), wb_addnum(), wb_endword(), wb_addop()
+ *      wb_fillargv()
+ */
+
+/* INCLUDES */
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <ctype.h>
+#include    <unistd.h>
+#include    "smsh.h"
+#include    "splitline.h"
+#include    "varlib.h"
+#include    "flexstr.h"
+#include    "tokscan.h"
+#include    "jobs.h"
+#include    "cmdsub.h"
+#include    "arith.h"
+#include    "arena.h"
+#include    "lexer.h"
+
+/* CONSTANTS */
+#define is_blank(x) ((x)==' ' || (x)=='\t')
+#define is_delim(x) ((x)==' ' || (x)=='\t' || (x)=='\0')
+#define LX_NBUFS    8                   // word buffers kept for reuse
+
+/* FILE-SCOPE VARIABLES */
+char lx_ops[LX_NOPS][3] = { "|", "&", "&&", "||" };    // text, for when
+                                                        //  one is printed
+
+static struct wordbuf bufs[LX_NBUFS];   // one per level of $(...) inside
+static int nbufs = 0;                   //  a line: those set up so far
+static int depth = 0;                   //  and those in use now
+
+/* INTERNAL FUNCTIONS */
+static char * lex_var(struct wordbuf *, char *, char *);
+static char * lex_cmdsub(struct wordbuf *, char *, char *, int);
+static char * lex_arith(struct wordbuf *, char *, char *);
+static char ** wb_finish(struct wordbuf *);
+static void start_word(struct wordbuf *);
+static int in_assign(struct wordbuf *);
+
+/*
+ *  lex_line()
+ *  Purpose: Substitute variables in a command line and split it into words
+ *    Input: line, the raw line (need not be '\0'-terminated; not changed)
+ *           len, its length
+ *   Return: NULL-terminated argv. It and its strings are in the arena, and
+ *           go when the caller releases its mark (see arena.c).
+ *     Note: A '\' at the very end of the line is kept as a '\'. A $(...)
+ *           in the line calls lex_line() again for its command, so each
+ *           level uses its own word buffer.
+ */
+char ** lex_line(char * line, size_t len)
+{
+    struct wordbuf local, *wbp;
+    char *cp = line, *end = line + len;
+    char c, prev = '\0';                    // line start counts as delim
+    size_t run;
+    char **argv;
+
+    if (depth < nbufs)                      // reuse the space of last time
+        wbp = &bufs[depth];
+    else if (depth < LX_NBUFS)
+        wb_init(wbp = &bufs[nbufs++]);
+    else                                    // nested very deep
+        wb_init(wbp = &local);
+    wb_reset(wbp);
+    cs_begin();
+    depth++;
+
+    while (cp < end)
+    {
+        run = ts_plain(cp, end - cp);       // copy plain text in one go
+        if (run > 0)
+        {
+            wb_addtext(wbp, cp, run);
+            prev = cp[run - 1];
+            cp += run;
+            continue;
+        }
+
+        c = *cp;
+        if (c == '#')
+        {
+            if (is_delim(prev))                         // comment
+                break;
+            wb_addtext(wbp, cp, 1);                     // in a word
+        }
+        else if (c == '\\' && cp + 1 < end)             // escape char
+        {
+            cp++;
+            if (is_blank(*cp))                          // still splits
+                wb_endword(wbp);
+            else
+                wb_addtext(wbp, cp, 1);
+        }
+        else if (c == '\\')                             // at the end
+            wb_addtext(wbp, cp, 1);
+        else if (c == '$' && cp + 2 < end && cp[1] == '(' && cp[2] == '(')
+        {                                               // $((expression))
+            cp = lex_arith(wbp, cp + 3, end);
+            prev = ')';
+            continue;                       // cp is past the "))" already
+        }
+        else if (c == '$' && cp + 1 < end && cp[1] == '(')
+        {                                               // $(command)
+            cp = lex_cmdsub(wbp, cp + 2, end, ')');
+            prev = ')';
+            continue;                       // cp is past the ')' already
+        }
+        else if (c == '$')                              // variable
+        {
+            cp = lex_var(wbp, cp + 1, end);
+            prev = c;
+            continue;                       // cp is past the name already
+        }
+        else if (c == '`')                              // `command`
+        {
+            cp = lex_cmdsub(wbp, cp + 1, end, '`');
+            prev = c;
+            continue;
+        }
+        else if (c == '|' || c == '&')                  // operator
+        {
+            wb_addop(wbp, lx_scanop(&cp, end));
+            c = ' ';                        // a '#' after it is a comment
+        }
+        else                                            // word break
+            wb_endword(wbp);
+
+        prev = c;
+        cp++;
+    }
+
+    wb_endword(wbp);
+    argv = wb_finish(wbp);
+
+    depth--;
+    if (wbp == &local)
+        wb_free(wbp);
+    return argv;
+}
+
+/*
+ *  lex_var()
+ *  Purpose: Add the value of the variable named at cp to the words
+ *    Input: cp, just past the '$'
+ *           end, the end of the line
+ *   Return: where the name ends
+ *     Note: As in get_var() before, the first char is always taken (so
+ *           '$$', '$?' and '$!' work), then any alpha-numeric or underscore
+ *           chars after it. A '$' at the end of the line adds nothing.
+ */
+char * lex_var(struct wordbuf * wb, char * cp, char * end)
+{
+    char *name = cp;
+
+    if (cp < end)
+        cp++;
+    while (cp < end && (isalnum(*cp) || *cp == '_'))
+        cp++;
+
+    if (cp - name == 1 && *name == '$')
+        wb_addnum(wb, getpid());
+    else if (cp - name == 1 && *name == '?')
+        wb_addnum(wb, get_exit());
+    else if (cp - name == 1 && *name == '!')
+    {
+        if (job_lastpid() != 0)             // empty until a job is run
+            wb_addnum(wb, job_lastpid());
+    }
+    else if (cp > name)
+        wb_addfield(wb, VLlookupn(name, cp - name));
+    return cp;
+}
+
+/*
+ *  lex_cmdsub()
+ *  Purpose: Add the output of the command in a substitution to the words
+ *    Input: cp, just past the "$(" or '`'
+ *           end, the end of the line
+ *           quote, what ends it: ')' or '`'
+ *   Return: where the substitution ends
+ */
+char * lex_cmdsub(struct wordbuf * wb, char * cp, char * end, int quote)
+{
+    FLEXSTR cmd;
+
+    fs_init(&cmd, 0);
+    cp = cs_scan(cp, end, quote, &cmd);
+    wb_addfield(wb, cs_run(fs_data(&cmd), cmd.fs_used));
+    fs_free(&cmd);
+    return cp;
+}
+
+/*
+ *  lex_arith()
+ *  Purpose: Add the value of an arithmetic expansion to the words
+ *    Input: cp, just past the "$(("
+ *           end, the end of the line
+ *   Return: where the expansion ends
+ *     Note: The value is a number, so it is added as it is, not split.
+ *           After an error nothing is added.
+ */
+char * lex_arith(struct wordbuf * wb, char * cp, char * end)
+{
+    char *stop = ax_scan(cp, end);
+    char *val = ax_value(ax_compile(cp, stop - cp));
+
+    if (val != NULL)
+        wb_addtext(wb, val, strlen(val));
+    return stop;
+}
+
+/*
+ *  lx_hasops()
+ *  Purpose: Tell whether an argv has any operator in it (so it is more
+ *           than one simple command)
+ */
+int lx_hasops(char ** args)
+{
+    for ( ; *args != NULL; args++)
+        if (lx_opcode(*args) != -1)
+            return 1;
+    return 0;
+}
+
+/*
+ *  lx_scanop()
+ *  Purpose: Read the operator at *cpp: '|', '&', '&&' or '||'
+ *   Return: its OP_ code; *cpp is left on its last char
+ */
+int lx_scanop(char ** cpp, char * end)
+{
+    char c = **cpp;
+
+    if (*cpp + 1 < end && (*cpp)[1] == c)           // doubled
+    {
+        (*cpp)++;
+        return (c == '&' ? OP_AND : OP_OR);
+    }
+    return (c == '&' ? OP_BG : OP_PIPE);
+}
+
+/*
+ *  lx_opcode()
+ *  Purpose: Tell an operator from a word in an argv
+ *   Return: the OP_ code if word is one of lx_ops[], else -1
+ */
+int lx_opcode(char * word)
+{
+    int op;
+
+    for (op = 0; op < LX_NOPS; op++)
+        if (word == lx_ops[op])
+            return op;
+    return -1;
+}
+
+/*
+ *  wb_finish()
+ *  Purpose: Copy the words into the arena and make an argv for them, in
+ *           the same block
+ *   Return: the argv. The word buffer is left as it was, to be reused.
+ *   Layout: [ argv ... NULL | words '\0' ... ]
+ */
+char ** wb_finish(struct wordbuf * wb)
+{
+    size_t argsz = (wb->wb_nwords + 1) * sizeof(char *);
+    char **argv = ar_alloc(argsz + wb->wb_text.fs_used);
+    char *text = (char *) argv + argsz;
+
+    memcpy(text, fs_data(&wb->wb_text), wb->wb_text.fs_used);
+    wb_fillargv(wb, argv, text);
+    return argv;
+}
+
+/*
+ *  wb_init()
+ *  Purpose: Start an empty word buffer
+ */
+void wb_init(struct wordbuf * wb)
+{
+    fs_init(&wb->wb_text, 0);
+    wb->wb_offs = NULL;
+    wb->wb_nwords = wb->wb_nslots = wb->wb_inword = 0;
+}
+
+/*
+ *  wb_reset()
+ *  Purpose: Empty a word buffer, but keep its space for the next words
+ */
+void wb_reset(struct wordbuf * wb)
+{
+    wb->wb_text.fs_used = 0;
+    wb->wb_nwords = wb->wb_inword = 0;
+}
+
+/*
+ *  wb_free()
+ *  Purpose: Release the space of a word buffer
+ */
+void wb_free(struct wordbuf * wb)
+{
+    fs_free(&wb->wb_text);
+    free(wb->wb_offs);
+}
+
+/*
+ *  start_word()
+ *  Purpose: Record where a new word starts
+ */
+void start_word(struct wordbuf * wb)
+{
+    if (wb->wb_nwords == wb->wb_nslots)
+    {
+        wb->wb_nslots = (wb->wb_nslots == 0 ? 8 : 2 * wb->wb_nslots);
+        wb->wb_offs = erealloc(wb->wb_offs, wb->wb_nslots * sizeof(size_t));
+    }
+    wb->wb_offs[wb->wb_nwords++] = wb->wb_text.fs_used;
+    wb->wb_inword = 1;
+}
+
+/*
+ *  wb_endword()
+ *  Purpose: Terminate the current word, if one was started
+ */
+void wb_endword(struct wordbuf * wb)
+{
+    if (wb->wb_inword)
+    {
+        fs_addch(&wb->wb_text, '\0');
+        wb->wb_inword = 0;
+    }
+}
+
+/*
+ *  wb_addop()
+ *  Purpose: End the current word and add an operator after it
+ */
+void wb_addop(struct wordbuf * wb, int op)
+{
+    wb_endword(wb);
+    start_word(wb);
+    wb->wb_offs[wb->wb_nwords - 1] = WB_OPOFF(op);
+    wb->wb_inword = 0;
+}
+
+/*
+ *  wb_fillargv()
+ *  Purpose: Point an argv at the words
+ *    Input: argv, room for wb_nwords + 1 pointers
+ *           text, where the words are now (wb_text may have been moved)
+ */
+void wb_fillargv(struct wordbuf * wb, char ** argv, char * text)
+{
+    size_t off;
+    int i;
+
+    for (i = 0; i < wb->wb_nwords; i++)
+    {
+        off = wb->wb_offs[i];
+        if (off >= WB_OPOFF(LX_NOPS - 1))
+            argv[i] = lx_ops[WB_OPOFF(0) - off];
+        else
+            argv[i] = text + off;
+    }
+    argv[i] = NULL;
+}
+
+/*
+ *  wb_addtext()
+ *  Purpose: Append text to the current word, starting one if needed
+ */
+void wb_addtext(struct wordbuf * wb, char * text, size_t len)
+{
+    if (len == 0)
+        return;
+    if (!wb->wb_inword)
+        start_word(wb);
+    fs_addnstr(&wb->wb_text, text, len);
+}
+
+/*
+ *  wb_addfield()
+ *  Purpose: Append a variable's value or a command's output, splitting it
+ *           at blanks and newlines: one of those ends the word just as a
+ *           blank in the line would
+ *     Note: As in sh, the value in an assignment (m=$(seq 3)) is not split:
+ *           it is added whole, newlines and all.
+ */
+void wb_addfield(struct wordbuf * wb, char * val)
+{
+    size_t run;
+
+    if (in_assign(wb))
+    {
+        wb_addtext(wb, val, strlen(val));
+        return;
+    }
+
+    while (*val)
+    {
+        if (is_blank(*val) || *val == '\n')
+        {
+            wb_endword(wb);
+            val++;
+            continue;
+        }
+        run = strcspn(val, " \t\n");      // copy up to the next blank
+        wb_addtext(wb, val, run);
+        val += run;
+    }
+}
+
+/*
+ *  in_assign()
+ *  Purpose: Tell whether the current word is an assignment: "name=" at
+ *           the start of a command (the only place one is run)
+ */
+int in_assign(struct wordbuf * wb)
+{
+    int n = wb->wb_nwords - 1;
+    char *word, *cp;
+
+    if (!wb->wb_inword)
+        return 0;
+    if (n > 0 && wb->wb_offs[n - 1] < WB_OPOFF(LX_NOPS - 1))
+        return 0;                           // a word after another
+
+    word = fs_data(&wb->wb_text) + wb->wb_offs[n];
+    cp = memchr(word, '=', wb->wb_text.fs_used - wb->wb_offs[n]);
+    if (cp == NULL || cp == word || isdigit((unsigned char) *word))
+        return 0;
+    while (--cp >= word)
+        if (!isalnum((unsigned char) *cp) && *cp != '_')
+            return 0;
+    return 1;
+}
+
+/*
+ *  wb_addnum()
+ *  Purpose: Append a number ($$, $? or $!) to the current word
+ */
+void wb_addnum(struct wordbuf * wb, int num)
+{
+    char buf[3 * sizeof(int) + 2];          // room for any int
+
+    wb_addtext(wb, buf, snprintf(buf, sizeof(buf), "%d", num));
+}
@@ -0,0 +1,57 @@
+/*
+ * ==========================
+ *   FILE: ./lexer.h
+ * ==========================
+ * Purpose: Header file for lexer.c
+ */
+
+#ifndef	LEXER_H
+#define	LEXER_H
+
+#include    <stddef.h>
+#include    "flexstr.h"
+
+/*
+ * Operators: an operator in a line comes back in the argv as a pointer
+ * to its entry in lx_ops[], not as a word, so "a | b" and "a \| b" (a
+ * word '|') can be told apart. Use lx_opcode() to check a word.
+ */
+enum lx_opcodes { OP_PIPE,          // |
+                  OP_BG,            // &
+                  OP_AND,           // &&
+                  OP_OR,            // ||
+                  LX_NOPS };
+
+extern char lx_ops[LX_NOPS][3];
+
+/*
+ * Words being built: the text of each word, '\0'-terminated, one after
+ * the other in wb_text, and where each one starts.
+ */
+struct wordbuf {
+    FLEXSTR     wb_text;        // the words
+    size_t *    wb_offs;        // offset of each word in wb_text, or
+                                //  WB_OPOFF(op) for an operator
+    int         wb_nwords;      // words started
+    int         wb_nslots;      // room in wb_offs
+    int         wb_inword;      // inside a word?
+};
+
+#define WB_OPOFF(op)    ((size_t) -1 - (op))
+
+char ** lex_line(char *line, size_t len);
+int lx_opcode(char *word);
+int lx_scanop(char **cpp, char *end);
+int lx_hasops(char **args);
+
+void wb_init(struct wordbuf *wb);
+void wb_reset(struct wordbuf *wb);
+void wb_free(struct wordbuf *wb);
+void wb_addtext(struct wordbuf *wb, char *text, size_t len);
+void wb_addfield(struct wordbuf *wb, char *val);
+void wb_addnum(struct wordbuf *wb, int num);
+void wb_endword(struct wordbuf *wb);
+void wb_addop(struct wordbuf *wb, int op);
+void wb_fillargv(struct wordbuf *wb, char **argv, char *text);
+
+#endif
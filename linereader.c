@@ -0,0 +1,347 @@
+/*
+ * ==========================
+ *   FILE: ./linereader.c
+ * ==========================
+ * Purpose: Read command lines for the shell, one line at a time.
+ *
+ * Outline: A script that is a regular file is mapped read-only into memory
+ * and its lines are handed out as (pointer, length) slices of the mapping,
+ * so nothing is copied or allocated per line. Anything else (a pipe, a
+ * device) is read straight from its file descriptor in large blocks.
+ * Either way, newlines are located with memchr(), which the C library
+ * scans a word (or vector register) at a time. Interactive input on stdin
+ * keeps using stdio, so the prompt is shown before every line and the
+ * 'read' built-in (which also reads stdin) never loses buffered input.
+ *
+ * interface:
+ *      lr_open(file)            -- open a script in mmap or block mode
+ *      lr_fromfp(fp)            -- wrap a stream (stdin) in stdio mode
+ *      lr_getline(lr, p, &len)  -- next line, without the '\n'
+ *      lr_stable(lr)            -- do lines outlive the next lr_getline()?
+ *      lr_clearerr(lr)          -- forget an EOF (interactive ^D)
+ *      lr_close(lr)             -- release the reader
+ */
+
+/* INCLUDES */
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <errno.h>
+#include    <fcntl.h>
+#include    <unistd.h>
+#include    <sys/mman.h>
+#include    <sys/stat.h>
+#include    "splitline.h"
+#include    "linereader.h"
+
+/* CONSTANTS */
+#define LR_BLOCKSIZE    (64 * 1024)     // bytes asked of each read()
+#define LR_LINESIZE     BUFSIZ          // starting buffer for stdio mode
+
+/* INTERNAL FUNCTIONS */
+static LINEREADER * lr_new(int mode, size_t size);
+static int map_script(LINEREADER *, int);
+static char * block_getline(LINEREADER *, size_t *);
+static char * mmap_getline(LINEREADER *, size_t *);
+static char * stdio_getline(LINEREADER *, char *, size_t *);
+static int fill_buffer(LINEREADER *);
+
+/*
+ *  lr_open()
+ *  Purpose: Open a script file, mapping it if it is a regular file and
+ *           falling back to block reads otherwise
+ *   Return: a new LINEREADER, or NULL if the file cannot be opened
+ */
+LINEREADER * lr_open(char * file)
+{
+    LINEREADER *lr;
+    int fd = open(file, O_RDONLY | O_CLOEXEC);  // children don't need it
+
+    if (fd == -1)
+        return NULL;
+
+    lr = emalloc(sizeof(LINEREADER));
+    if (map_script(lr, fd) == 0)
+        return lr;
+    free(lr);
+
+    lr = lr_new(LR_BLOCK, LR_BLOCKSIZE + 1);    // +1 for a '\0' at the end
+    lr->lr_fd = fd;
+    return lr;
+}
+
+/*
+ *  map_script()
+ *  Purpose: Set up a reader over a read-only mapping of the script
+ *   Return: 0 on success, -1 if fd is not a non-empty regular file or
+ *           cannot be mapped (the caller then reads it in blocks)
+ *     Note: The mapping is private and read-only, so the script must not
+ *           be truncated while the shell runs it (it would get SIGBUS).
+ */
+int map_script(LINEREADER * lr, int fd)
+{
+    struct stat info;
+    void *map;
+
+    if (fstat(fd, &info) == -1 || !S_ISREG(info.st_mode) || info.st_size == 0)
+        return -1;
+
+    map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+        return -1;
+    madvise(map, info.st_size, MADV_SEQUENTIAL);    // read front to back
+
+    lr->lr_mode  = LR_MMAP;
+    lr->lr_fd    = fd;
+    lr->lr_fp    = NULL;
+    lr->lr_buf   = map;
+    lr->lr_size  = info.st_size;
+    lr->lr_start = lr->lr_scan = 0;
+    lr->lr_end   = info.st_size;
+    lr->lr_eof   = 1;                           // it is all there already
+    return 0;
+}
+
+/*
+ *  lr_fromfp()
+ *  Purpose: Fallback reader for interactive input. Lines are pulled from
+ *           the stream with getc() so the prompt goes out before each line
+ *           and no input beyond the current line is consumed.
+ *   Return: a new LINEREADER
+ */
+LINEREADER * lr_fromfp(FILE * fp)
+{
+    LINEREADER *lr = lr_new(LR_STDIO, LR_LINESIZE);
+
+    lr->lr_fp = fp;
+    return lr;
+}
+
+/*
+ *  lr_new()
+ *  Purpose: Allocate a reader and its buffer
+ */
+LINEREADER * lr_new(int mode, size_t size)
+{
+    LINEREADER *lr = emalloc(sizeof(LINEREADER));
+
+    lr->lr_mode  = mode;
+    lr->lr_fd    = -1;
+    lr->lr_fp    = NULL;
+    lr->lr_buf   = emalloc(size);
+    lr->lr_size  = size;
+    lr->lr_start = lr->lr_scan = lr->lr_end = 0;
+    lr->lr_eof   = 0;
+    return lr;
+}
+
+/*
+ *  lr_getline()
+ *  Purpose: Get the next line of input
+ *    Input: lr, the reader
+ *           prompt, shown before reading (stdio mode only)
+ *           lenp, where to store the length of the line (may be NULL)
+ *   Return: pointer to the line, without its '\n', or NULL at EOF. The
+ *           line is *lenp bytes long and is NOT '\0'-terminated in
+ *           LR_MMAP mode. It lives in the reader's buffer and is only good
+ *           until the next call; copy it to keep it.
+ */
+char * lr_getline(LINEREADER * lr, char * prompt, size_t * lenp)
+{
+    size_t len;
+    char *line;
+
+    if (lr->lr_mode == LR_MMAP)
+        line = mmap_getline(lr, &len);
+    else if (lr->lr_mode == LR_STDIO)
+        line = stdio_getline(lr, prompt, &len);
+    else
+        line = block_getline(lr, &len);
+
+    if (line != NULL && lenp != NULL)
+        *lenp = len;
+    return line;
+}
+
+/*
+ *  block_getline()
+ *  Purpose: Find the next line in the block buffer, reading more as needed
+ *   Method: memchr() looks for the '\n' in the bytes not yet scanned. When
+ *           there is none, the partial line is moved to the front of the
+ *           buffer (or the buffer is doubled when the line fills it), and
+ *           another block is read in behind it. The '\n' is overwritten
+ *           with '\0' so the line can be used as a C string in place.
+ */
+char * block_getline(LINEREADER * lr, size_t * lenp)
+{
+    char *line, *nl;
+
+    while (1)
+    {
+        nl = memchr(lr->lr_buf + lr->lr_scan, '\n', lr->lr_end - lr->lr_scan);
+
+        if (nl != NULL)                         // found a complete line
+        {
+            line = lr->lr_buf + lr->lr_start;
+            *nl = '\0';
+            *lenp = nl - line;
+            lr->lr_start = lr->lr_scan = (nl + 1) - lr->lr_buf;
+            return line;
+        }
+
+        lr->lr_scan = lr->lr_end;               // nothing in there
+
+        if (lr->lr_eof)
+        {
+            if (lr->lr_start == lr->lr_end)     // EOF and no input
+                return NULL;
+
+            line = lr->lr_buf + lr->lr_start;   // last line, no '\n'
+            lr->lr_buf[lr->lr_end] = '\0';      // room was kept for this
+            *lenp = lr->lr_end - lr->lr_start;
+            lr->lr_start = lr->lr_scan = lr->lr_end;
+            return line;
+        }
+
+        if (fill_buffer(lr) == -1)
+            lr->lr_eof = 1;                     // treat errors as EOF
+    }
+}
+
+/*
+ *  mmap_getline()
+ *  Purpose: Slice the next line out of the mapped script. Nothing is
+ *           copied and nothing is written (the mapping is read-only).
+ */
+char * mmap_getline(LINEREADER * lr, size_t * lenp)
+{
+    char *line = lr->lr_buf + lr->lr_start;
+    size_t left = lr->lr_end - lr->lr_start;
+    char *nl;
+
+    if (left == 0)                              // EOF
+        return NULL;
+
+    if ( (nl = memchr(line, '\n', left)) != NULL )
+    {
+        *lenp = nl - line;
+        lr->lr_start += *lenp + 1;
+    }
+    else                                        // last line, no '\n'
+    {
+        *lenp = left;
+        lr->lr_start = lr->lr_end;
+    }
+    return line;
+}
+
+/*
+ *  fill_buffer()
+ *  Purpose: Make room behind the unread data and read another block
+ *   Return: 0 on success (EOF is noted in lr_eof), -1 on a read error
+ */
+int fill_buffer(LINEREADER * lr)
+{
+    size_t unread = lr->lr_end - lr->lr_start;
+    ssize_t n;
+
+    if (lr->lr_start > 0)                       // slide partial line down
+    {
+        memmove(lr->lr_buf, lr->lr_buf + lr->lr_start, unread);
+        lr->lr_start = 0;
+        lr->lr_scan  = lr->lr_end = unread;
+    }
+
+    if (lr->lr_size - lr->lr_end <= LR_BLOCKSIZE / 2)  // a long line
+    {
+        lr->lr_size = 2 * lr->lr_size;
+        lr->lr_buf  = erealloc(lr->lr_buf, lr->lr_size);
+    }
+
+    do
+        n = read(lr->lr_fd, lr->lr_buf + lr->lr_end,
+                 lr->lr_size - lr->lr_end - 1);
+    while (n == -1 && errno == EINTR);
+
+    if (n == -1)
+    {
+        perror("read");
+        return -1;
+    }
+
+    if (n == 0)
+        lr->lr_eof = 1;
+
+    lr->lr_end += n;
+    return 0;
+}
+
+/*
+ *  stdio_getline()
+ *  Purpose: Show the prompt and read one line with getc(), into the
+ *           reader's buffer (reused from line to line).
+ *     Note: Matches next_cmd(): a final line without a '\n' is still
+ *           returned, and NULL only comes back for EOF with no input.
+ */
+char * stdio_getline(LINEREADER * lr, char * prompt, size_t * lenp)
+{
+    size_t pos = 0;
+    int c;
+
+    printf("%s", prompt);
+    fflush(stdout);
+
+    while ( (c = getc(lr->lr_fp)) != EOF && c != '\n' )
+    {
+        if (pos + 1 == lr->lr_size)             // keep room for the '\0'
+        {
+            lr->lr_size = 2 * lr->lr_size;
+            lr->lr_buf  = erealloc(lr->lr_buf, lr->lr_size);
+        }
+        lr->lr_buf[pos++] = c;
+    }
+
+    if (c == EOF && pos == 0)                   // EOF and no input
+        return NULL;
+
+    lr->lr_buf[pos] = '\0';
+    *lenp = pos;
+    return lr->lr_buf;
+}
+
+/*
+ *  lr_stable()
+ *  Purpose: Tell callers if lines stay valid after the next lr_getline().
+ *           Lines sliced from a mapped script last until lr_close(), so
+ *           they can be kept without copying them.
+ *   Return: 1 if they do, 0 if they must be copied to be kept
+ */
+int lr_stable(LINEREADER * lr)
+{
+    return lr->lr_mode == LR_MMAP;
+}
+
+/*
+ *  lr_clearerr()
+ *  Purpose: Clear an EOF so an interactive shell can keep reading
+ */
+void lr_clearerr(LINEREADER * lr)
+{
+    if (lr->lr_mode == LR_STDIO)
+        clearerr(lr->lr_fp);
+}
+
+/*
+ *  lr_close()
+ *  Purpose: Release the reader, closing the script if there is one
+ */
+void lr_close(LINEREADER * lr)
+{
+    if (lr->lr_fd != -1)
+        close(lr->lr_fd);
+    if (lr->lr_mode == LR_MMAP)
+        munmap(lr->lr_buf, lr->lr_size);
+    else
+        free(lr->lr_buf);
+    free(lr);
+}
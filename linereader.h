@@ -0,0 +1,36 @@
+/*
+ * ==========================
+ *   FILE: ./linereader.h
+ * ==========================
+ * Purpose: Header file for linereader.c
+ */
+
+#ifndef	LINEREADER_H
+#define	LINEREADER_H
+
+#include    <stdio.h>
+
+enum lr_modes { LR_BLOCK, LR_MMAP, LR_STDIO };
+
+struct linereader {
+    int     lr_mode;        // LR_BLOCK, LR_MMAP or LR_STDIO
+    int     lr_fd;          // script file descriptor (LR_BLOCK, LR_MMAP)
+    FILE *  lr_fp;          // stream for the fallback (LR_STDIO)
+    char *  lr_buf;         // input buffer, or the mapped script
+    size_t  lr_size;        // allocated (or mapped) size of lr_buf
+    size_t  lr_start;       // start of the unread data
+    size_t  lr_scan;        // data before this has no '\n' in it
+    size_t  lr_end;         // end of the unread data
+    int     lr_eof;         // no more data to read
+};
+
+typedef struct linereader LINEREADER;
+
+LINEREADER * lr_open(char *file);
+LINEREADER * lr_fromfp(FILE *fp);
+char * lr_getline(LINEREADER *lr, char *prompt, size_t *lenp);
+int lr_stable(LINEREADER *lr);
+void lr_clearerr(LINEREADER *lr);
+void lr_close(LINEREADER *lr);
+
+#endif
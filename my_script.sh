@@ -31,3 +31,84 @@ fi
 # Test variable assignment (test #8 from course-script)
 ./smsh test_assign.sh
 echo "Exit status is $?, expecting non-zero"
+
+# Test keywords, builtins and pipelines (stderr differs: not compared)
+./smsh test_builtins.sh > test_builtins.out.smsh 2>/dev/null
+dash test_builtins.sh > test_builtins.out.dash 2>/dev/null
+diff test_builtins.out.smsh test_builtins.out.dash
+
+if [ $? -eq 0 ]
+then
+    echo Correctly handled builtins and pipelines.
+else
+    echo Failed builtin and pipeline handling.
+fi
+rm test_builtins.out.smsh test_builtins.out.dash
+
+# Test command substitution, run as a script and then from stdin (a child
+# that rewinds the shared stdin makes lines run twice); prompts taken off
+./smsh test_cmdsub.sh > test_cmdsub.out.smsh 2>/dev/null
+./smsh < test_cmdsub.sh 2>/dev/null | sed 's/^\(> \)*//' > test_cmdsub.in.smsh
+dash test_cmdsub.sh > test_cmdsub.out.dash 2>/dev/null
+diff test_cmdsub.out.smsh test_cmdsub.out.dash &&
+diff test_cmdsub.in.smsh test_cmdsub.out.dash
+
+if [ $? -eq 0 ]
+then
+    echo Correctly handled command substitution.
+else
+    echo Failed command substitution handling.
+fi
+rm test_cmdsub.out.smsh test_cmdsub.in.smsh test_cmdsub.out.dash
+
+# Test while and until loops
+./smsh test_while.sh > test_while.out.smsh 2>/dev/null
+dash test_while.sh > test_while.out.dash 2>/dev/null
+diff test_while.out.smsh test_while.out.dash
+
+if [ $? -eq 0 ]
+then
+    echo Correctly handled while and until loops.
+else
+    echo Failed while and until loop handling.
+fi
+rm test_while.out.smsh test_while.out.dash
+
+# Test && and || lists
+./smsh test_andor.sh > test_andor.out.smsh 2>/dev/null
+dash test_andor.sh > test_andor.out.dash 2>/dev/null
+diff test_andor.out.smsh test_andor.out.dash
+
+if [ $? -eq 0 ]
+then
+    echo Correctly handled and-or lists.
+else
+    echo Failed and-or list handling.
+fi
+rm test_andor.out.smsh test_andor.out.dash
+
+# Test arithmetic expansion
+./smsh test_arith.sh > test_arith.out.smsh 2>/dev/null
+dash test_arith.sh > test_arith.out.dash 2>/dev/null
+diff test_arith.out.smsh test_arith.out.dash
+
+if [ $? -eq 0 ]
+then
+    echo Correctly handled arithmetic.
+else
+    echo Failed arithmetic handling.
+fi
+rm test_arith.out.smsh test_arith.out.dash
+
+# Test background jobs and wait
+./smsh test_jobs.sh > test_jobs.out.smsh 2>/dev/null
+dash test_jobs.sh > test_jobs.out.dash 2>/dev/null
+diff test_jobs.out.smsh test_jobs.out.dash
+
+if [ $? -eq 0 ]
+then
+    echo Correctly handled background jobs.
+else
+    echo Failed background job handling.
+fi
+rm test_jobs.out.smsh test_jobs.out.dash
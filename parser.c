@@ -0,0 +1,551 @@
+/*
+ * ==========================
+ *   FILE: ./parser.c
+ * ==========================
+ * Purpose: Read if-blocks and loops into a tree before they are run.
+ *
+ * Outline: parse_next() reads one complete top-level construct -- a single
+ * command line, or a whole if/then/else/fi block, for/do/done loop or
+ * while (until)/do/done loop with everything nested inside it -- and
+ * returns it as a tree of nodes (see
+ * parser.h). Each line is classified once, by its leading keyword, when
+ * it is read; the text of commands is stored raw and only substituted and
+ * split when controlflow.c runs it. Loops therefore never re-read or
+ * re-classify their bodies, and blocks can be nested inside each other.
+ *
+ * A line that is an and-or list ("a && b || c") is cut into its commands,
+ * each a node of its own, by split_andor() -- not when it is read, but
+ * when controlflow.c first runs it, so lines that never run are never
+ * scanned. controlflow.c can then skip the commands the status says not
+ * to run without even substituting them.
+ *
+ * The nodes, and the copies of text they keep, are allocated in the arena
+ * (see arena.c): main() releases them all at once when the construct has
+ * been run, and free_tree() only has the templates to free.
+ *
+ * Syntax errors are reported here, with the same messages 'dash' uses.
+ * In a script they are fatal; interactively, the construct is dropped
+ * and $? is set to 2.
+ */
+
+/* INCLUDES */
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    "smsh.h"
+#include    "splitline.h"
+#include    "builtin.h"
+#include    "linereader.h"
+#include    "cmdtable.h"
+#include    "arena.h"
+#include    "lexer.h"
+#include    "cmdsub.h"
+#include    "parser.h"
+
+/* FILE-SCOPE VARIABLES */
+static LINEREADER * source;         // where lines come from
+static char * prompt;               // shown before each line
+static char * line;                 // the current line
+static size_t line_len;             // and its length
+static char * rest;                 // the current line after its keyword
+static size_t rest_len;             // and its length
+
+/* INTERNAL FUNCTIONS */
+static int next_line();
+static int classify(char *, size_t);
+static int parse_list(struct node **, int, int);
+static int parse_if(struct node **);
+static int parse_for(struct node **);
+static int parse_while(struct node **, int);
+static int parse_jobs(struct node *);
+static int add_andor(struct node ***, char *, char *, int);
+static void init_node(struct node *, int, char *, size_t);
+static void free_andor(struct node *);
+static int next_word(char **, char *, size_t *);
+static struct node * new_node(int, char *, size_t, int);
+static int unexpected(int);
+static int unexpected_op(int);
+static int syn_err(char *);
+
+/*
+ *  parse_next()
+ *  Purpose: Read the next top-level construct from lr
+ *    Input: lr, the line reader
+ *           pr, the prompt to show before each line
+ *           treep, where to store the tree that was read
+ *   Return: P_OK with *treep set; P_EOF at the end of input; or P_ERROR
+ *           after a syntax error (interactive mode only -- a script exits)
+ */
+int parse_next(LINEREADER * lr, char * pr, struct node ** treep)
+{
+    int kw, rv = 0;
+
+    source = lr;
+    prompt = pr;
+    *treep = NULL;
+
+    kw = next_line();
+
+    if (kw == KW_EOF)
+        return P_EOF;
+
+    if (kw == KW_NONE)                      // a plain command is run right
+        *treep = new_node(N_CMD, line, line_len, 0);   // away: no copy
+    else if (kw == KW_IF)
+        rv = parse_if(treep);
+    else if (kw == KW_FOR)
+        rv = parse_for(treep);
+    else if (kw == KW_WHILE || kw == KW_UNTIL)
+        rv = parse_while(treep, kw);
+    else
+        rv = unexpected(kw);
+
+    if (rv == -1)
+    {
+        free_tree(*treep);
+        *treep = NULL;
+        return P_ERROR;
+    }
+    return P_OK;
+}
+
+/*
+ *  next_line()
+ *  Purpose: Read lines until one that is not blank or a comment
+ *   Return: the class of the line (KW_EOF at the end of input); the line
+ *           and the text after its keyword are left in file-scope vars
+ */
+int next_line()
+{
+    int kw;
+
+    do
+    {
+        line = lr_getline(source, prompt, &line_len);
+        if (line == NULL)
+            return KW_EOF;
+        kw = classify(line, line_len);
+    }
+    while (kw == KW_BLANK);
+
+    return kw;
+}
+
+/*
+ *  classify()
+ *  Purpose: Find out what kind of line this is from its first word
+ *   Return: KW_BLANK for an empty or comment line, KW_NONE for a command,
+ *           else the keyword. rest/rest_len are set to what follows it.
+ */
+int classify(char * str, size_t len)
+{
+    char *end = str + len;
+    char *word = str;
+    size_t wlen;
+    struct command *cp;
+
+    if (next_word(&word, end, &wlen) == 0 || word[0] == '#')
+        return KW_BLANK;
+
+    cp = cmd_lookup(word, wlen);            // see cmdtable.c
+
+    rest = word + wlen;
+    rest_len = end - rest;
+    return (cp != NULL ? cp->cm_kw : KW_NONE);
+}
+
+/*
+ *  parse_list()
+ *  Purpose: Read commands and nested blocks into a list until one of the
+ *           keywords that can end the list
+ *    Input: listp, where to store the list
+ *           end1, end2, the keywords that end the list
+ *   Return: the keyword that ended the list, or -1 on a syntax error
+ */
+int parse_list(struct node ** listp, int end1, int end2)
+{
+    struct node **tailp = listp;
+    int kw, rv = 0;
+
+    while (rv != -1)
+    {
+        kw = next_line();
+
+        if (kw == end1 || kw == end2)
+            return kw;
+
+        if (kw == KW_EOF)
+            rv = syn_err("end of file unexpected");
+        else if (kw == KW_NONE)
+            *tailp = new_node(N_CMD, line, line_len, 1);
+        else if (kw == KW_IF)
+            rv = parse_if(tailp);
+        else if (kw == KW_FOR)
+            rv = parse_for(tailp);
+        else if (kw == KW_WHILE || kw == KW_UNTIL)
+            rv = parse_while(tailp, kw);
+        else
+            rv = unexpected(kw);
+
+        if (*tailp != NULL)                 // link even a partial node in
+            tailp = &(*tailp)->n_next;      // so free_tree() can find it
+    }
+    return -1;
+}
+
+/*
+ *  parse_if()
+ *  Purpose: Read an if/then/else/fi block; the "if" line is current
+ *   Return: 0 if ok, -1 on a syntax error
+ */
+int parse_if(struct node ** np)
+{
+    struct node *n = new_node(N_IF, rest, rest_len, 1);
+    int kw;
+
+    *np = n;
+
+    kw = next_line();                       // must be "then"
+    if (kw == KW_EOF)
+        return syn_err("end of file unexpected");
+    if (kw == KW_NONE)
+        return syn_err("then expected");
+    if (kw != KW_THEN)
+        return unexpected(kw);
+
+    kw = parse_list(&n->n_body, KW_ELSE, KW_FI);
+
+    if (kw == KW_ELSE)
+        kw = parse_list(&n->n_else, KW_FI, KW_FI);
+
+    return (kw == -1 ? -1 : 0);
+}
+
+/*
+ *  parse_for()
+ *  Purpose: Read a for/do/done loop; the "for" line is current
+ *   Return: 0 if ok, -1 on a syntax error
+ *     Note: The words after "in" are kept as text: like any command, they
+ *           are substituted each time the loop is run, not when read.
+ */
+int parse_for(struct node ** np)
+{
+    char *word = rest, *end = rest + rest_len;
+    size_t wlen;
+    struct node *n;
+    int kw;
+
+    if (next_word(&word, end, &wlen) == 0)
+        return syn_err("Bad for loop variable");
+
+    n = new_node(N_FOR, NULL, 0, 0);
+    *np = n;
+    n->n_name = ar_strndup(word, wlen);
+    if ( !okname(n->n_name) )
+        return syn_err("Bad for loop variable");
+
+    word += wlen;                           // then "in"
+    if (next_word(&word, end, &wlen) == 0 || wlen != 2 ||
+        memcmp(word, "in", 2) != 0)
+        return syn_err("word unexpected (expecting \"in\")");
+
+    word += wlen;                           // the values are the rest
+    n->n_len   = end - word;
+    n->n_text  = (lr_stable(source) ? word : ar_strndup(word, n->n_len));
+
+    kw = next_line();                       // must be "do"
+    if (kw == KW_EOF)
+        return syn_err("end of file unexpected");
+    if (kw != KW_DO)
+        return syn_err("word unexpected (expecting \"do\")");
+    if (parse_jobs(n) == -1)
+        return -1;
+
+    kw = parse_list(&n->n_body, KW_DONE, KW_DONE);
+
+    return (kw == -1 ? -1 : 0);
+}
+
+/*
+ *  parse_while()
+ *  Purpose: Read a while/do/done or until/do/done loop; the "while" or
+ *           "until" line is current
+ *    Input: np, where to store the node
+ *           kw, KW_WHILE or KW_UNTIL
+ *   Return: 0 if ok, -1 on a syntax error
+ *     Note: The condition is the rest of the line, as for "if". It is run
+ *           before each pass like any command in the body (see
+ *           controlflow.c).
+ */
+int parse_while(struct node ** np, int kw)
+{
+    struct node *n;
+
+    n = new_node(kw == KW_WHILE ? N_WHILE : N_UNTIL, rest, rest_len, 1);
+    *np = n;
+
+    kw = next_line();                       // must be "do"
+    if (kw == KW_EOF)
+        return syn_err("end of file unexpected");
+    if (kw != KW_DO)
+        return syn_err("word unexpected (expecting \"do\")");
+
+    kw = parse_list(&n->n_body, KW_DONE, KW_DONE);
+
+    return (kw == -1 ? -1 : 0);
+}
+
+/*
+ *  parse_jobs()
+ *  Purpose: Read the "-j N" that may follow "do"; the "do" line is current
+ *   Return: 0 if ok (n->n_jobs is set), -1 on a syntax error
+ *     Note: "-j" alone means one pass per CPU. N is a plain number: it is
+ *           read once, here, not substituted when the loop runs.
+ */
+int parse_jobs(struct node * n)
+{
+    char *word = rest, *end = rest + rest_len, *num;
+    size_t wlen;
+    long jobs;
+
+    if (next_word(&word, end, &wlen) == 0 || wlen != 2 ||
+        memcmp(word, "-j", 2) != 0)
+        return 0;                           // a plain "do"
+
+    word += wlen;
+    if (next_word(&word, end, &wlen) == 0)
+    {
+        n->n_jobs = FOR_NCPUS;
+        return 0;
+    }
+
+    num = ar_strndup(word, wlen);
+    jobs = strtol(num, &word, 10);
+    if (*word != '\0' || jobs < 1 || jobs > 4096)
+        return syn_err("Bad number of jobs after -j");
+    n->n_jobs = jobs;
+    return 0;
+}
+
+/*
+ *  split_andor()
+ *  Purpose: Cut a command line that is an and-or list into its commands;
+ *           called by controlflow.c the first time the line runs
+ *    Input: n, the node of the line (N_CMD), or of a condition (N_IF,
+ *           N_WHILE, N_UNTIL)
+ *   Return: 0 if ok, with n->n_andor set if the line is a list; -1 on a
+ *           syntax error (reported)
+ *     Note: The operators are found the way lex_line() finds them: not
+ *           after a '\', inside $(...) or `...`, or in a comment. A line
+ *           with a '&' on it as well is not cut up; process() runs the
+ *           whole of it once its words are substituted. The commands are
+ *           made with malloc(), not in the arena: the arena is released
+ *           after each pass of a loop, and they last as long as the tree.
+ */
+int split_andor(struct node * n)
+{
+    char *cp = n->n_text, *end = cp + n->n_len, *start = cp;
+    struct node *list = NULL, **tailp = &list;
+    int c, prev = ' ', op = -1, kind = -1;
+
+    n->n_split = 1;
+
+    for ( ; cp < end; prev = c, cp++)
+    {
+        c = *cp;
+        if (c == '\\' && cp + 1 < end)
+            cp++;
+        else if (c == '#' && (prev == ' ' || prev == '\t'))
+            break;                          // the rest is a comment
+        else if (c == '`')
+            cp = cs_scan(cp + 1, end, '`', NULL) - 1;
+        else if (c == '$' && cp + 1 < end && cp[1] == '(')
+            cp = cs_scan(cp + 2, end, ')', NULL) - 1;
+        else if (c == '|' || c == '&')
+        {
+            op = lx_scanop(&cp, end);
+            if (op == OP_BG)
+            {
+                free_andor(list);
+                return 0;
+            }
+            if (op == OP_AND || op == OP_OR)
+            {
+                if (add_andor(&tailp, start, cp - 1, kind) == -1)
+                {
+                    free_andor(list);
+                    return unexpected_op(op);
+                }
+                start = cp + 1;
+                kind = op;
+            }
+            c = ' ';                        // a '#' after it is a comment
+        }
+    }
+
+    if (kind == -1)                         // a plain command
+        return 0;
+    if (add_andor(&tailp, start, end, kind) == -1)
+    {
+        free_andor(list);
+        return unexpected_op(kind);
+    }
+    n->n_andor = list;
+    return 0;
+}
+
+/*
+ *  add_andor()
+ *  Purpose: Add one command of an and-or list to the end of it
+ *    Input: tailpp, where the link to it goes (moved on past it)
+ *           start, end, its text
+ *           op, OP_AND or OP_OR before it, or -1 for the first
+ *   Return: 0 if ok, -1 if it is empty (blank, or only a comment)
+ */
+int add_andor(struct node *** tailpp, char * start, char * end, int op)
+{
+    char *cp = start;
+
+    while (cp < end && (*cp == ' ' || *cp == '\t'))
+        cp++;
+    if (cp == end || *cp == '#')
+        return -1;
+
+    **tailpp = emalloc(sizeof(struct node));
+    init_node(**tailpp, N_CMD, start, end - start);     // in n_text already
+    (**tailpp)->n_op = op;
+    *tailpp = &(**tailpp)->n_next;
+    return 0;
+}
+
+/*
+ *  next_word()
+ *  Purpose: Skip blanks to the next word, stopping at end
+ *   Return: 1 with *wp at the word and *lenp its length, 0 if no word left
+ */
+int next_word(char ** wp, char * end, size_t * lenp)
+{
+    char *cp = *wp;
+    char *start;
+
+    while (cp < end && (*cp == ' ' || *cp == '\t'))
+        cp++;
+    start = cp;
+    while (cp < end && *cp != ' ' && *cp != '\t')
+        cp++;
+
+    *wp = start;
+    *lenp = cp - start;
+    return cp != start;
+}
+
+/*
+ *  new_node()
+ *  Purpose: Make a node for text, copying the text if it has to outlive
+ *           the current line
+ *    Input: type, the node type
+ *           text, len, the raw text
+ *           keep, 1 if the text must stay valid after the next line is read
+ */
+struct node * new_node(int type, char * text, size_t len, int keep)
+{
+    struct node *n = ar_alloc(sizeof(struct node));
+
+    init_node(n, type,
+              (keep && !lr_stable(source) ? ar_strndup(text, len) : text), len);
+    return n;
+}
+
+/*
+ *  init_node()
+ *  Purpose: Fill in a new node for text, with nothing under it yet
+ */
+void init_node(struct node * n, int type, char * text, size_t len)
+{
+    n->n_type  = type;
+    n->n_text  = text;
+    n->n_len   = len;
+    n->n_tmpl  = NULL;
+    n->n_runs  = 0;
+    n->n_name  = NULL;
+    n->n_jobs  = 0;
+    n->n_op    = -1;
+    n->n_split = 0;
+    n->n_andor = n->n_body = n->n_else = n->n_next = NULL;
+}
+
+/*
+ *  free_tree()
+ *  Purpose: Release the templates of a list of nodes and everything under
+ *           them (the nodes themselves go with the arena, except the
+ *           commands of an and-or list, see free_andor())
+ */
+void free_tree(struct node * tree)
+{
+    for ( ; tree != NULL; tree = tree->n_next)
+    {
+        free_andor(tree->n_andor);
+        free_tree(tree->n_body);
+        free_tree(tree->n_else);
+        tm_free(tree->n_tmpl);
+    }
+}
+
+/*
+ *  free_andor()
+ *  Purpose: Release the commands of an and-or list (made by malloc())
+ */
+void free_andor(struct node * cmd)
+{
+    struct node *next;
+
+    for ( ; cmd != NULL; cmd = next)
+    {
+        next = cmd->n_next;
+        tm_free(cmd->n_tmpl);
+        free(cmd);
+    }
+}
+
+/*
+ *  unexpected()
+ *  Purpose: Report a keyword found where it does not belong
+ */
+int unexpected(int kw)
+{
+    static char *names[] = { "end of file", "", "",
+                             "if", "then", "else", "fi",
+                             "for", "do", "done",
+                             "while", "until" };
+    char msg[32];
+
+    snprintf(msg, sizeof(msg), "%s unexpected", names[kw]);
+    return syn_err(msg);
+}
+
+/*
+ *  unexpected_op()
+ *  Purpose: Report an operator with no command on one side of it
+ */
+int unexpected_op(int op)
+{
+    char msg[32];
+
+    snprintf(msg, sizeof(msg), "\"%s\" unexpected", lx_ops[op]);
+    return syn_err(msg);
+}
+
+int syn_err(char *msg)
+/* purpose: handles syntax errors in control structures
+ * details: sets $? to 2, the exit status for a syntax error
+ * returns: -1 in interactive mode. Calls fatal in scripts
+ */
+{
+    if(get_mode() == SCRIPTED)
+        fatal("syntax error: ", msg, 2);
+
+    complain("syntax error: %s\n", msg);
+    set_exit(2);
+
+    return -1;
+}
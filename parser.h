@@ -0,0 +1,63 @@
+/*
+ * ==========================
+ *   FILE: ./parser.h
+ * ==========================
+ * Purpose: Header file for parser.c
+ */
+
+#ifndef	PARSER_H
+#define	PARSER_H
+
+#include    <stddef.h>
+#include    "linereader.h"
+#include    "template.h"
+
+/* NODE TYPES */
+enum node_types { N_CMD, N_IF, N_FOR, N_WHILE, N_UNTIL };
+
+/* n_jobs OF A LOOP WITH "do -j": ONE PASS PER CPU */
+#define FOR_NCPUS   (-1)
+
+/* RESULTS OF parse_next() */
+enum parse_results { P_EOF, P_OK, P_ERROR };
+
+/*
+ * One node of the parsed script. Lists of nodes (a script, a then-part,
+ * a loop body) are chained through n_next.
+ *   N_CMD -- n_text is the command line
+ *   N_IF  -- n_text is the condition, n_body the then-part and n_else
+ *            the else-part (NULL if there is none)
+ *   N_FOR -- n_name is the loop variable, n_text the words after 'in'
+ *            (substituted each time the loop starts) and n_body the body;
+ *            n_jobs is N from "do -j N": how many passes may run at once
+ *   N_WHILE, N_UNTIL -- n_text is the condition, run before each pass,
+ *            and n_body the body
+ * A command line or condition that is an and-or list ("a && b || c") gets
+ * n_andor when it first runs (see split_andor()): its commands, as a list
+ * of N_CMD nodes, each with n_op, the OP_AND or OP_OR before it (-1 for
+ * the first). It is run through them.
+ * A node that runs more than once (in a loop body) also gets n_tmpl, n_text
+ * compiled by template.c, the second time it runs.
+ */
+struct node {
+    int             n_type;         // one of node_types
+    char *          n_text;         // raw text (not '\0'-terminated)
+    size_t          n_len;          // length of n_text
+    struct template *n_tmpl;        // compiled n_text, or NULL
+    int             n_runs;         // times run before it had n_tmpl
+    struct node *   n_andor;        // the commands of an and-or list
+    int             n_op;           // in one: OP_AND or OP_OR before it
+    int             n_split;        // has split_andor() looked at it?
+    char *          n_name;         // N_FOR: variable name
+    int             n_jobs;         // N_FOR: 0 to run the passes in turn,
+                                    //  FOR_NCPUS for "-j" with no N
+    struct node *   n_body;         // N_IF, N_FOR, N_WHILE: nested list
+    struct node *   n_else;         // N_IF: else list
+    struct node *   n_next;         // next node in the list
+};
+
+int parse_next(LINEREADER *lr, char *prompt, struct node **treep);
+void free_tree(struct node *tree);
+int split_andor(struct node *n);
+
+#endif
@@ -0,0 +1,261 @@
+/*
+ * ==========================
+ *   FILE: ./pathcache.c
+ * ==========================
+ * Purpose: Remember where commands were found in PATH.
+ *
+ * Outline: execvp() tries every directory in PATH for every command it
+ * runs, so a loop that calls 'grep' over and over does the same failed
+ * execve() calls each time. pc_lookup() searches PATH once per command
+ * name and keeps the full path it found in a small hash table (open
+ * addressing, like the one in varlib.c), so later runs go straight to it.
+ * A name that is not found anywhere is reported before any process is
+ * started. Names with a '/' in them are used as they are.
+ *
+ * The table is emptied when PATH is assigned (VLstore() calls pc_clear()),
+ * and an entry is dropped if its file has gone away (see execute()). A
+ * command found through a relative dir in PATH ("bin", or "." or an empty
+ * entry) is only good in the dir it was found from, so as in dash those
+ * entries are dropped when 'cd' changes directory. The 'hash' builtin
+ * lists the table, adds names to it, or clears it.
+ *
+ * interface:
+ *      pc_lookup(name)  -- full path of a command, or NULL if not found
+ *      pc_forget(name)  -- drop one entry
+ *      pc_clear()       -- drop all entries
+ *      pc_chdir()       -- drop the ones found through relative dirs
+ *      pc_list()        -- print the entries (for 'hash')
+ */
+
+/* INCLUDES */
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <unistd.h>
+#include    <sys/stat.h>
+#include    "splitline.h"
+#include    "varlib.h"
+#include    "pathcache.h"
+
+/* CONSTANTS */
+#define DFL_PATH    "/bin:/usr/bin"     // what execvp() uses with no PATH
+#define MINSLOTS    32
+
+/* one remembered command */
+struct pc_entry {
+    char *      pe_name;            // command name, NULL if slot is free
+    char *      pe_path;            // where it was found
+    unsigned    pe_hash;            // hash of pe_name
+};
+
+/* FILE-SCOPE VARIABLES */
+static struct pc_entry * table = NULL;
+static unsigned nslots = 0;         // a power of 2
+static unsigned nused = 0;
+
+/* INTERNAL FUNCTIONS */
+static struct pc_entry * find_slot(char *, unsigned);
+static char * search_path(char *);
+static void grow_table();
+static unsigned hash_name(char *);
+
+/*
+ *  pc_lookup()
+ *  Purpose: Find the program to run for a command name
+ *    Input: name, the command (argv[0])
+ *   Return: its full path (owned by the cache, or name itself if it has
+ *           a '/'), or NULL if it is not in any PATH directory
+ */
+char * pc_lookup(char * name)
+{
+    struct pc_entry *pe;
+    unsigned h;
+    char *path;
+
+    if (strchr(name, '/') != NULL)          // not looked up in PATH
+        return name;
+
+    h = hash_name(name);
+    if (nslots > 0 && (pe = find_slot(name, h))->pe_name != NULL)
+        return pe->pe_path;
+
+    if ((path = search_path(name)) == NULL)
+        return NULL;
+
+    if (2 * (nused + 1) > nslots)           // keep it half empty
+        grow_table();
+    pe = find_slot(name, h);
+    pe->pe_name = newstr(name, strlen(name));
+    pe->pe_path = path;
+    pe->pe_hash = h;
+    nused++;
+    return path;
+}
+
+/*
+ *  search_path()
+ *  Purpose: Look for an executable file called name in each PATH dir
+ *   Return: a malloc()ed full path, or NULL if there is none
+ *     Note: An empty entry in PATH means the current directory.
+ */
+char * search_path(char * name)
+{
+    char *dirs = VLlookup("PATH");
+    char *end, *path;
+    size_t dlen, nlen = strlen(name);
+    struct stat info;
+
+    if (*dirs == '\0')
+        dirs = DFL_PATH;
+
+    for ( ; ; dirs = end + 1)
+    {
+        end = dirs + strcspn(dirs, ":");
+        dlen = end - dirs;
+
+        path = emalloc(dlen + nlen + 3);    // dir '/' name '\0', or ./name
+        if (dlen == 0)
+            path[dlen++] = '.';
+        else
+            memcpy(path, dirs, dlen);
+        path[dlen] = '/';
+        memcpy(path + dlen + 1, name, nlen + 1);
+
+        if (stat(path, &info) == 0 && S_ISREG(info.st_mode) &&
+            access(path, X_OK) == 0)
+            return path;
+        free(path);
+
+        if (*end == '\0')
+            return NULL;
+    }
+}
+
+/*
+ *  find_slot()
+ *  Purpose: Find the entry for name, or the free slot where it would go
+ *     Note: The table must have at least one free slot.
+ */
+struct pc_entry * find_slot(char * name, unsigned h)
+{
+    unsigned mask = nslots - 1;
+    unsigned i;
+
+    for (i = h & mask; table[i].pe_name != NULL; i = (i + 1) & mask)
+        if (table[i].pe_hash == h && strcmp(table[i].pe_name, name) == 0)
+            break;
+    return &table[i];
+}
+
+/*
+ *  grow_table()
+ *  Purpose: Double the table and put every entry back in
+ */
+void grow_table()
+{
+    struct pc_entry *old = table;
+    unsigned oldslots = nslots, i;
+
+    nslots = (nslots == 0 ? MINSLOTS : 2 * nslots);
+    table = emalloc(nslots * sizeof(struct pc_entry));
+    for (i = 0; i < nslots; i++)
+        table[i].pe_name = NULL;
+
+    for (i = 0; i < oldslots; i++)
+        if (old[i].pe_name != NULL)
+            *find_slot(old[i].pe_name, old[i].pe_hash) = old[i];
+    free(old);
+}
+
+/*
+ *  pc_forget()
+ *  Purpose: Drop the entry for one name (its file moved or went away)
+ *     Note: With linear probing, the entries after it in the same run
+ *           are put back in, so none of them is cut off from its home.
+ */
+void pc_forget(char * name)
+{
+    struct pc_entry *pe, moved;
+    unsigned mask = nslots - 1, i;
+
+    if (nslots == 0 || (pe = find_slot(name, hash_name(name)))->pe_name == NULL)
+        return;
+
+    free(pe->pe_name);
+    free(pe->pe_path);
+    pe->pe_name = NULL;
+    nused--;
+
+    for (i = (pe - table + 1) & mask; table[i].pe_name != NULL; i = (i + 1) & mask)
+    {
+        moved = table[i];
+        table[i].pe_name = NULL;
+        *find_slot(moved.pe_name, moved.pe_hash) = moved;
+    }
+}
+
+/*
+ *  pc_clear()
+ *  Purpose: Forget every command (PATH changed, or 'hash -r')
+ */
+void pc_clear()
+{
+    unsigned i;
+
+    for (i = 0; i < nslots; i++)
+        if (table[i].pe_name != NULL)
+        {
+            free(table[i].pe_name);
+            free(table[i].pe_path);
+            table[i].pe_name = NULL;
+        }
+    nused = 0;
+}
+
+/*
+ *  pc_chdir()
+ *  Purpose: Forget every command whose path does not start with '/'
+ *           (the shell has changed directory)
+ *     Note: pc_forget() may move a later entry of the same run into the
+ *           slot it empties, so that slot is looked at again.
+ */
+void pc_chdir()
+{
+    unsigned i = 0;
+
+    while (i < nslots)
+    {
+        if (table[i].pe_name != NULL && table[i].pe_path[0] != '/')
+            pc_forget(table[i].pe_name);
+        else
+            i++;
+    }
+}
+
+/*
+ *  pc_list()
+ *  Purpose: Print the full path of each remembered command
+ */
+void pc_list()
+{
+    unsigned i;
+
+    for (i = 0; i < nslots; i++)
+        if (table[i].pe_name != NULL)
+            printf("%s\n", table[i].pe_path);
+}
+
+/*
+ *  hash_name() -- FNV-1a hash of a command name
+ */
+unsigned hash_name(char * name)
+{
+    unsigned h = 2166136261u;
+
+    while (*name)
+    {
+        h ^= (unsigned char) *name++;
+        h *= 16777619u;
+    }
+    return h;
+}
@@ -0,0 +1,17 @@
+/*
+ * ==========================
+ *   FILE: ./pathcache.h
+ * ==========================
+ * Purpose: Header file for pathcache.c
+ */
+
+#ifndef	PATHCACHE_H
+#define	PATHCACHE_H
+
+char * pc_lookup(char *name);
+void pc_forget(char *name);
+void pc_clear();
+void pc_chdir();
+void pc_list();
+
+#endif
@@ -0,0 +1,420 @@
+/*
+ * ==========================
+ *   FILE: ./pipeline.c
+ * ==========================
+ * Purpose: Run a command line with '|' in it, all of its stages at once.
+ *
+ * Outline: lex_line() hands back "a | b | c" as one argv with OP_PIPE
+ * operators between the commands (see lexer.h). run_pipeline() cuts it
+ * into stages and joins each pair of programs with a pipe made by pipe2()
+ * with O_CLOEXEC, so the only copy of a pipe end a child gets is the one
+ * sp_start() puts on its fd 0 or 1. Every program is started before any
+ * of them is waited for, so the stages run side by side, and then all of
+ * them are reaped. $? is the status of the last stage.
+ *
+ * A pure builtin (echo, test, printf, ...; see cmdtable.c) is not run in
+ * a child: it changes nothing in the shell, so it is run there. So is
+ * 'read' at the end of a pipeline, so that it sets the variable in the
+ * shell. Any other builtin (cd, exit, x=1, ...) is run in a child of the
+ * shell, forked by fork_stage(), so that, as in sh, what it changes is
+ * lost and 'exit' only ends that stage. The shell can only run one
+ * builtin at a time, and must never wait on a pipe it still has to fill,
+ * so the work is done in this order:
+ *      1. make the pipes between programs (and forked builtins)
+ *      2. run each builtin that is not the last stage and is run in the
+ *         shell, with no input and its output going to a memfd (a file in
+ *         memory), and hand that to the next stage (see feed())
+ *      3. start all the programs and forked builtins
+ *      4. run the last stage, if it is a builtin run in the shell, reading
+ *         from the stage before it
+ *      5. wait for all the children
+ * A builtin's output is moved into the next stage's pipe by splice(): the
+ * kernel passes the memfd's pages to the pipe without the data going
+ * through a buffer in the shell. The pipe is made big enough first, so
+ * this is done before the reader starts. Output too big for a pipe, or
+ * going to a builtin, is not moved at all: the reader gets the memfd as
+ * its input. Where there is no memfd_create() or splice() (not Linux), a
+ * tmpfile() takes the place of the memfd, and is always given as it is.
+ *
+ * interface:
+ *      is_pipeline(args)   -- does an argv have a '|' in it?
+ *      run_pipeline(args)  -- run one; returns the status of the last stage
+ *      make_memfd()        -- an unnamed file to hold output (also used by
+ *                             parallel for-loops, see controlflow.c)
+ */
+
+/* INCLUDES */
+#define     _GNU_SOURCE                 // pipe2(), splice(), memfd_create()
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <unistd.h>
+#include    <fcntl.h>
+#include    <sys/types.h>
+#include    "smsh.h"
+#include    "splitline.h"
+#include    "builtin.h"
+#include    "process.h"
+#include    "spawner.h"
+#include    "lexer.h"
+#include    "arena.h"
+#include    "cmdtable.h"
+#include    "jobs.h"
+#include    "pipeline.h"
+
+#ifdef __linux__
+#include    <sys/mman.h>
+#endif
+
+/* CONSTANTS */
+#define FEED_MAX    (1 << 20)           // most to splice() into one pipe
+                                        //  (the usual pipe-max-size)
+
+/* one command in a pipeline */
+struct stage {
+    char ** st_args;            // its words, NULL-terminated
+    int     st_builtin;         // run in the shell?
+    int     st_fork;            // a builtin run in a child of the shell?
+    pid_t   st_pid;             // the program, -1 if none is running
+    int     st_status;          // its exit status
+    int     st_in;              // fd for its stdin, -1 for the shell's
+    int     st_out;             // fd for its stdout, -1 for the shell's
+};
+
+/* INTERNAL FUNCTIONS */
+static int cut_stages(char **, struct stage **);
+static int in_shell(char **, int);
+static int make_pipes(struct stage *, int);
+static pid_t fork_stage(struct stage *, int, int);
+static int run_captured(struct stage *, struct stage *, int);
+static int feed(int, int);
+static void run_last(struct stage *);
+static void close_fds(struct stage *);
+
+/*
+ *  is_pipeline()
+ *  Purpose: Tell whether a command line has a '|' operator in it
+ */
+int is_pipeline(char ** args)
+{
+    for ( ; *args != NULL; args++)
+        if (lx_opcode(*args) == OP_PIPE)
+            return 1;
+    return 0;
+}
+
+/*
+ *  run_pipeline()
+ *  Purpose: Run the stages of a pipeline together, in the order above
+ *    Input: args, the argv with OP_PIPE operators in it. The operators
+ *           are replaced by NULLs.
+ *   Return: the status of the last stage, 1 if the pipeline could not be
+ *           set up, or -1 on a syntax error
+ */
+int run_pipeline(char ** args)
+{
+    struct stage *st;
+    int fds[SP_NFDS];
+    int n, i;
+
+    if ((n = cut_stages(args, &st)) == -1)
+        return syntax_error(lx_ops[OP_PIPE]);
+
+    if (make_pipes(st, n) == -1)
+        return 1;
+
+    for (i = 0; i < n - 1; i++)                 // builtins that feed others
+        if (st[i].st_builtin &&
+            run_captured(&st[i], &st[i + 1], i + 1 == n - 1) == -1)
+        {
+            for (i = 0; i < n; i++)
+                close_fds(&st[i]);
+            return 1;
+        }
+
+    for (i = 0; i < n; i++)                     // start every program
+        if (st[i].st_fork)
+            st[i].st_pid = fork_stage(st, n, i);
+        else if (!st[i].st_builtin)
+        {
+            fds[SP_IN] = st[i].st_in;
+            fds[SP_OUT] = st[i].st_out;
+            fds[SP_ERR] = -1;
+            st[i].st_pid = start_command(st[i].st_args, fds, &st[i].st_status);
+        }
+
+    for (i = 0; i < n - 1; i++)                 // shell keeps only what
+        close_fds(&st[i]);                      //  the last stage reads
+    if (st[n - 1].st_builtin)
+        run_last(&st[n - 1]);
+    else
+        close_fds(&st[n - 1]);
+
+    for (i = 0; i < n; i++)                     // reap them all
+        if (st[i].st_pid != -1)
+            st[i].st_status = wait_command(st[i].st_pid);
+
+    return st[n - 1].st_status;
+}
+
+/*
+ *  cut_stages()
+ *  Purpose: Split a pipeline's argv into its commands, in place
+ *   Return: the number of stages, or -1 if one of them is empty
+ *           (*stp is set to an array of them in the arena, not set on error)
+ */
+int cut_stages(char ** args, struct stage ** stp)
+{
+    struct stage *st;
+    int n = 1, i, k;
+
+    for (i = 0; args[i] != NULL; i++)
+        if (lx_opcode(args[i]) == OP_PIPE)
+            n++;
+
+    st = ar_alloc(n * sizeof(struct stage));    // gone with the command
+    st[0].st_args = args;
+    for (i = 0, k = 0; ; i++)
+    {
+        if (args[i] != NULL && lx_opcode(args[i]) != OP_PIPE)
+            continue;
+        if (st[k].st_args == &args[i])          // nothing before the '|'
+            return -1;
+        if (args[i] == NULL)
+            break;
+        args[i] = NULL;
+        st[++k].st_args = &args[i + 1];
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        st[i].st_builtin = in_shell(st[i].st_args, i == n - 1);
+        st[i].st_fork = !st[i].st_builtin && is_builtin_cmd(st[i].st_args);
+        st[i].st_pid = -1;
+        st[i].st_status = 0;
+        st[i].st_in = st[i].st_out = -1;
+    }
+    *stp = st;
+    return n;
+}
+
+/*
+ *  in_shell()
+ *  Purpose: Tell whether a stage is a builtin that can be run in the shell
+ *    Input: args, the stage
+ *           last, is it the last stage?
+ *   Return: 1 for a pure builtin, or 'read' at the end; 0 for a program or
+ *           any other builtin
+ */
+int in_shell(char ** args, int last)
+{
+    struct command *cp = cmd_lookup(args[0], strlen(args[0]));
+
+    if (cp == NULL || cp->cm_run == NULL)       // a program, or x=1
+        return 0;
+    return (cp->cm_pure || (last && cp->cm_run == is_read));
+}
+
+/*
+ *  make_pipes()
+ *  Purpose: Make a pipe after every program or forked builtin that is not
+ *           the last stage (a builtin run in the shell has its output
+ *           connected later, by run_captured())
+ *   Return: 0 if ok, -1 if a pipe could not be made (none are left open)
+ */
+int make_pipes(struct stage * st, int n)
+{
+    int i, p[2];
+
+    for (i = 0; i < n - 1; i++)
+    {
+        if (st[i].st_builtin)
+            continue;
+        if (pipe2(p, O_CLOEXEC) == -1)
+        {
+            perror("pipe");
+            for (i = 0; i < n; i++)
+                close_fds(&st[i]);
+            return -1;
+        }
+        st[i].st_out = p[1];
+        st[i + 1].st_in = p[0];
+    }
+    return 0;
+}
+
+/*
+ *  run_captured()
+ *  Purpose: Run a builtin that is not the last stage, with no input and its
+ *           output going into memory, and give that output to the next stage
+ *    Input: sp, the builtin
+ *           next, the stage after it
+ *           nextlast, is next the last stage?
+ *   Return: 0 if ok, -1 if there was nowhere to put the output
+ *     Note: A builtin in the middle does not read, so output going to one
+ *           is thrown away, as it would be by the builtin itself.
+ */
+int run_captured(struct stage * sp, struct stage * next, int nextlast)
+{
+    FILE *none;
+    int mfd, saved;
+
+    if ((mfd = make_memfd()) == -1 || (saved = dup(1)) == -1)
+    {
+        perror("pipeline");
+        if (mfd != -1)
+            close(mfd);
+        return -1;
+    }
+
+    none = fopen("/dev/null", "r");             // stdin is not for it
+    set_builtin_input(none);
+    fflush(stdout);
+    dup2(mfd, 1);
+    is_builtin(sp->st_args, &sp->st_status);
+    fflush(stdout);
+    dup2(saved, 1);
+    close(saved);
+    set_builtin_input(NULL);
+    if (none != NULL)
+        fclose(none);
+
+    if (next->st_builtin && !nextlast)
+        close(mfd);
+    else
+        next->st_in = feed(mfd, !next->st_builtin);
+    return 0;
+}
+
+/*
+ *  fork_stage()
+ *  Purpose: Run a builtin that could change the shell in a child of it
+ *    Input: st, n, all the stages
+ *           i, the one to run
+ *   Return: the child's pid, or -1 if there is none (st_status is set)
+ *     Note: The child closes its copies of the other stages' fds, or a
+ *           stage could wait for ever for the end of a pipe it holds open.
+ */
+pid_t fork_stage(struct stage * st, int n, int i)
+{
+    struct stage *sp = &st[i];
+    FILE *in;
+    pid_t pid;
+    int k;
+
+    fflush(stdout);                             // or the child prints it again
+    if ((pid = fork()) == 0)
+    {
+        jobs_clear();                           // the shell's, not ours
+        if (sp->st_in != -1)
+            dup2(sp->st_in, 0);
+        if (sp->st_out != -1)
+            dup2(sp->st_out, 1);
+        for (k = 0; k < n; k++)
+            close_fds(&st[k]);
+        if ((in = fdopen(0, "r")) != NULL)
+            set_builtin_input(in);              // not what stdin had buffered
+        is_builtin(sp->st_args, &sp->st_status);
+        shell_exit(sp->st_status);              // not exit(): see smsh.c
+    }
+    if (pid == -1)
+    {
+        perror("fork");
+        sp->st_status = 1;
+    }
+    return pid;
+}
+
+/*
+ *  feed()
+ *  Purpose: Turn a builtin's output into the next stage's input
+ *    Input: mfd, the memfd holding it (at the end of the output)
+ *           topipe, should it go into a pipe if it can?
+ *   Return: the fd the next stage should read: a pipe with all the output
+ *           in it and no writer left, or mfd itself moved back to the start
+ *     Note: splice() moves the pages from mfd to the pipe; SPLICE_F_NONBLOCK
+ *           makes sure the shell cannot hang if the pipe is full after all.
+ */
+int feed(int mfd, int topipe)
+{
+#ifdef __linux__
+    loff_t off = 0, size = lseek(mfd, 0, SEEK_CUR);
+    ssize_t n;
+    int p[2];
+
+    if (topipe && size <= FEED_MAX && pipe2(p, O_CLOEXEC) == 0)
+    {
+        if (fcntl(p[1], F_SETPIPE_SZ, (int) size) >= size)
+            while (off < size && (n = splice(mfd, &off, p[1], NULL,
+                                             size - off, SPLICE_F_NONBLOCK)) > 0)
+                ;
+        if (off == size)
+        {
+            close(p[1]);
+            close(mfd);
+            return p[0];
+        }
+        close(p[0]);                            // give it the memfd instead
+        close(p[1]);
+    }
+#endif
+    lseek(mfd, 0, SEEK_SET);
+    return mfd;
+}
+
+/*
+ *  run_last()
+ *  Purpose: Run the builtin at the end of a pipeline, reading from the
+ *           stage before it, with its output going where the shell's goes
+ */
+void run_last(struct stage * sp)
+{
+    FILE *fp = NULL;
+
+    if (sp->st_in != -1 && (fp = fdopen(sp->st_in, "r")) == NULL)
+        close(sp->st_in);
+    sp->st_in = -1;
+
+    set_builtin_input(fp);
+    is_builtin(sp->st_args, &sp->st_status);
+    set_builtin_input(NULL);
+
+    if (fp != NULL)                             // a writer still going
+        fclose(fp);                             //  gets SIGPIPE now
+}
+
+/*
+ *  make_memfd()
+ *  Purpose: Make an unnamed file for a builtin's output
+ *   Return: its fd (close-on-exec), or -1
+ */
+int make_memfd()
+{
+#ifdef __linux__
+    return memfd_create("smsh-pipe", MFD_CLOEXEC);
+#else
+    FILE *fp = tmpfile();
+    int fd = -1;
+
+    if (fp != NULL)
+    {
+        if ((fd = dup(fileno(fp))) != -1)
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        fclose(fp);                             // the file lives on in fd
+    }
+    return fd;
+#endif
+}
+
+/*
+ *  close_fds()
+ *  Purpose: Close the shell's copies of a stage's input and output
+ */
+void close_fds(struct stage * sp)
+{
+    if (sp->st_in != -1)
+        close(sp->st_in);
+    if (sp->st_out != -1)
+        close(sp->st_out);
+    sp->st_in = sp->st_out = -1;
+}
@@ -0,0 +1,15 @@
+/*
+ * ==========================
+ *   FILE: ./pipeline.h
+ * ==========================
+ * Purpose: Header file for pipeline.c
+ */
+
+#ifndef	PIPELINE_H
+#define	PIPELINE_H
+
+int is_pipeline(char **args);
+int run_pipeline(char **args);
+int make_memfd();
+
+#endif
@@ -8,51 +8,171 @@
  * It sits in front of the do_command function which sits 
  * in front of the execute() function.  This layer handles
  * two main classes of processing:
- *  a) process - checks for flow control (if, while, for ...)
+ *  a) process - skips empty command lines
  *  b) do_command - does the command by 
  *               1. Is command built-in? (exit, set, read, cd, ...)
  *                       2. If not builtin, run the program (fork, exec...)
  *
- * Most of this file has remained un-modified from the starter code. A few
- * lines were added in process() to handle for loop processing. In execute()
- * code has been added to convert the status returned from wait() to a proper
- * exit status.
+ * Most of this file has remained un-modified from the starter code. Flow
+ * control (if, for) used to be checked for in process(); it is now read
+ * by parser.c and run by controlflow.c before commands get here. In
+ * execute() code has been added to convert the status returned from wait()
+ * to a proper exit status. The child's environment is now made ready by
+ * the parent (VLenviron() keeps it between commands) instead of being
+ * rebuilt in every child, and programs are started by spawner.c with
+ * posix_spawn() instead of fork() and exec. A line with '|' in it is
+ * handed to run_pipeline() (see pipeline.c). Commands ending in '&' are
+ * started by run_background() and left to jobs.c. What is left of the line
+ * is an and-or list ("a && b || c"), run by run_andor().
  */
 
 /* INCLUDES */
 #include    <stdio.h>
 #include    <stdlib.h>
+#include    <errno.h>
 #include    <unistd.h>
-#include    <signal.h>
+#include    <fcntl.h>
 #include    <sys/wait.h>
 #include    "smsh.h"
 #include    "builtin.h"
 #include    "varlib.h"
-#include    "controlflow.h"
+#include    "spawner.h"
+#include    "pathcache.h"
+#include    "pipeline.h"
+#include    "lexer.h"
+#include    "jobs.h"
 #include    "process.h"
 
+/* FILE-SCOPE VARIABLES */
+static int async = 0;       /* starting a background job, or in one */
+
 int process(char *args[])
 /*
- * purpose: process user command: this level handles flow control
- * returns: result of processing command
+ * purpose: process user command
+ * returns: result of processing command (0 for a background job, as
+ *          in sh)
  *  errors: arise from subroutines, handled there
+ *    note: each part of the line that ends in '&' is started in the
+ *          background first, then the rest is run and waited for
  */
 {
     int     rv = 0;
+    int     i;
+
+    for (i = 0; args[i] != NULL; i++)
+    {
+        if (lx_opcode(args[i]) != OP_BG)
+            continue;
+        if (i == 0)                 // nothing before the '&'
+            return syntax_error(lx_ops[OP_BG]);
+        args[i] = NULL;
+        rv = run_background(args);
+        args += i + 1;
+        i = -1;
+    }
 
     if (args[0] == NULL)   //just a new line
-        rv = 0;
-    else if ( is_control_command(args[0]) )
-        rv = do_control_command(args);
-    else if ( is_for_loop(args[0]) )            // added for assignment
-        rv = do_for_loop(args);                 // added for assignment
-    else if ( ok_to_execute() )
-        rv = do_command(args);
+        ;
+    else
+        rv = run_andor(args);
         
     return rv;
 }
 
+int run_andor(char *args[])
+/*
+ * purpose: run an and-or list: commands (or pipelines) joined by && and ||
+ * returns: the status of the last command run, or -1 on a syntax error
+ *    note: a command after && only runs if the status so far is 0, one
+ *          after || only if it is not; one that does not run leaves the
+ *          status as it was. The whole list is checked before any of it
+ *          runs. Here its words were all substituted at once; a line
+ *          that is just an and-or list is split up by the parser instead,
+ *          so that each command is substituted only when it is reached.
+ */
+{
+    char    **cmd = args;
+    int     rv = 0, op = -1, next, i;
 
+    for (i = 0; args[i] != NULL; i++)
+    {
+        next = lx_opcode(args[i]);
+        if ( next != OP_AND && next != OP_OR )
+            continue;
+        if ( i == 0 || args[i + 1] == NULL ||
+             (next = lx_opcode(args[i - 1])) == OP_AND || next == OP_OR )
+            return syntax_error(args[i]);
+    }
+
+    for (i = 0; ; i++)
+    {
+        next = (args[i] == NULL ? -1 : lx_opcode(args[i]));
+        if ( args[i] != NULL && next != OP_AND && next != OP_OR )
+            continue;
+        args[i] = NULL;
+        if ( op == -1 || (op == OP_AND) == (rv == 0) ){
+            rv = is_pipeline(cmd) ? run_pipeline(cmd) : do_command(cmd);
+            if ( rv == -1 )
+                return rv;
+            set_exit(rv);           /* for $? and 'exit' in what follows */
+        }
+        if ( next == -1 )
+            return rv;
+        op = next;
+        cmd = &args[i + 1];
+    }
+}
+
+int run_background(char *args[])
+/*
+ * purpose: start a command (or a pipeline) and do not wait for it
+ * returns: 0, or the status if it could not be started
+ *    note: As in sh without job control, the job reads /dev/null and
+ *          ignores SIGINT and SIGQUIT. A program is started directly.
+ *          A builtin, a pipeline or an and-or list needs a shell of its
+ *          own to run in, so one is forked; what it changes (cd,
+ *          variables) is lost.
+ */
+{
+    int     fds[SP_NFDS] = { -1, -1, -1 };
+    int     rv = 0, num;
+    pid_t   pid;
+    FILE    *in;
+
+    fds[SP_IN] = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+    if ( !lx_hasops(args) && !is_builtin_cmd(args) ){
+        async = 1;
+        pid = start_command(args, fds, &rv);
+        async = 0;
+    }
+    else {
+        fflush(stdout);             /* or the child prints it again */
+        if ( (pid = fork()) == 0 ){
+            async = 1;
+            jobs_clear();
+            if ( fds[SP_IN] != -1 )
+                dup2(fds[SP_IN], 0);
+            if ( (in = fdopen(0, "r")) != NULL )
+                set_builtin_input(in);  /* not what stdin had buffered */
+            rv = run_andor(args);
+            shell_exit(rv == -1 ? 2 : rv);  /* not exit(): see smsh.c */
+        }
+        if ( pid == -1 ){
+            perror("fork");
+            rv = 1;
+        }
+    }
+    if ( fds[SP_IN] != -1 )
+        close(fds[SP_IN]);
+
+    if ( pid == -1 )
+        return rv;
+    num = job_add(pid);
+    if ( get_mode() == INTERACTIVE )
+        fprintf(stderr, "[%d] %d\n", num, pid);
+    return 0;
+}
 
 /*
  * do_command
@@ -76,39 +196,114 @@ int execute(char *argv[])
 /*
  * purpose: run a program passing it arguments
  * returns: status returned via wait, or -1 on error
- *  errors: -1 on fork() or wait() errors
+ *  errors: -1 on wait() errors; 127 if the program is not found (checked
+ *          before anything is started); 1 if it could not be started
+ *          for another reason
  *    note: this function was modified from the starter code to interpret
  *          the exit status received from wait to get the exit(n) status.
  *          This is set in the special variable $? back in smsh.c
+ *          Starting the child and waiting for it are now done by
+ *          start_command() and wait_command(), which pipeline.c uses too.
  */
 {
-    extern char **environ;      /* note: declared in <unistd.h> */
-    int pid ;
-    int child_info = -1;
+    pid_t pid ;
     int rv = -1;
 
     if ( argv[0] == NULL )      /* nothing succeeds     */
         return 0;
 
-    if ( (pid = fork())  == -1 )
-        perror("fork");
-    else if ( pid == 0 ){
-        environ = VLtable2environ();
-        signal(SIGINT, SIG_DFL);
-        signal(SIGQUIT, SIG_DFL);
-        execvp(argv[0], argv);
+    if ( (pid = start_command(argv, NULL, &rv)) == -1 )
+        return rv;
+    return wait_command(pid);
+}
+
+pid_t start_command(char *argv[], int *fds, int *rvp)
+/*
+ * purpose: start a program running, but do not wait for it
+ *    args: fds, NULL or the fds for the child (see sp_start())
+ *          rvp, where to put the status if the program is not started
+ * returns: the pid of the child, or -1 with *rvp set (127 if the program
+ *          is not found, 1 if it could not be started) after saying why
+ *    note: The child is started by sp_start() (see spawner.c), which does
+ *          what the child used to do after fork() before it exec'ed.
+ *          The program is found through the path cache (pathcache.c).
+ *          stdout is flushed first, so what builtins have printed so far
+ *          comes out before anything the program prints.
+ */
+{
+    extern char **environ;      /* note: declared in <unistd.h> */
+    char **env, *path;
+    pid_t pid = -1;
+
+    fflush(stdout);
+
+    if ( (env = VLenviron()) == NULL )  /* built only if it changed */
+        env = environ;
+
+    if ( (path = pc_lookup(argv[0])) != NULL )
+        pid = sp_start(path, argv, env, fds, async ? SP_ASYNC : 0);
+    else
+        errno = ENOENT;
+    if ( pid == -1 && errno == ENOENT && path != NULL && path != argv[0] ){
+        pc_forget(argv[0]);     /* it moved: look again, once */
+        if ( (path = pc_lookup(argv[0])) != NULL )
+            pid = sp_start(path, argv, env, fds, async ? SP_ASYNC : 0);
+        else
+            errno = ENOENT;
+    }
+    if ( pid == -1 && errno == ENOENT ){
+        complain("%s: not found\n", argv[0]);
+        *rvp = 127;
+    }
+    else if ( pid == -1 ){
         perror("cannot execute command");
-        exit(1);
+        *rvp = 1;               /* what the child used to exit with */
     }
-    else {
-        if ( wait(&child_info) == -1 )
-            perror("wait");
-        
-        // check/convert the exit status to the proper value
-        if (WIFEXITED(child_info))
-            rv = WEXITSTATUS(child_info);
-        else if (WIFSIGNALED(child_info))
-            rv = WTERMSIG(child_info);
+    return pid;
+}
+
+int wait_command(pid_t pid)
+/*
+ * purpose: wait for a child started by start_command()
+ * returns: its exit status, or the signal that killed it; -1 if wait fails
+ */
+{
+    int child_info = -1;
+
+    if ( waitpid(pid, &child_info, 0) == -1 ){
+        perror("wait");
+        return -1;
     }
+    return child_status(child_info);
+}
+
+int child_status(int child_info)
+/*
+ * purpose: check/convert a status from wait() to the proper exit status
+ * returns: the exit(n) value, or the signal that killed the child
+ */
+{
+    int rv = -1;
+
+    if (WIFEXITED(child_info))
+        rv = WEXITSTATUS(child_info);
+    else if (WIFSIGNALED(child_info))
+        rv = WTERMSIG(child_info);
     return rv;
 }
+
+int syntax_error(char *op)
+/*
+ * purpose: report an operator where a command should be
+ * returns: -1 (a syntax error) in interactive mode. Calls fatal in
+ *          scripts, as parser.c does for if and for.
+ */
+{
+    char msg[32];
+
+    snprintf(msg, sizeof(msg), "\"%s\" unexpected", op);
+    if ( get_mode() == SCRIPTED )
+        fatal("syntax error: ", msg, 2);
+    complain("syntax error: %s\n", msg);
+    return -1;
+}
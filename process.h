@@ -11,8 +11,16 @@
 #ifndef	PROCESS_H
 #define	PROCESS_H
 
+#include    <sys/types.h>
+
 int process(char **args);
+int run_background(char **args);
+int run_andor(char **args);
 int do_command(char **args);
 int execute(char **args);
+pid_t start_command(char **args, int *fds, int *rvp);
+int wait_command(pid_t pid);
+int child_status(int child_info);
+int syntax_error(char *op);
 
 #endif
@@ -8,20 +8,32 @@
  * each performing a specific task. This file contains the main loop which
  * calls on the other files to operate. For more information, see the Plan
  * document, or function comments in each of the files.
+ *       linereader.c -- read command lines from a script or stdin
  *        splitline.c -- string I/O and management
+ *            lexer.c -- substitute variables and split lines into words
+ *           parser.c -- read if-blocks and loops into a tree
+ *      controlflow.c -- run if-blocks and loops from the tree
  *          process.c -- execute programs
+ *         pipeline.c -- run the stages of a pipeline together
+ *             jobs.c -- keep track of background jobs ('&', 'wait')
+ *          spawner.c -- start programs without fork()
  *           varlib.c -- manage variables and the environment
- *      controlflow.c -- read if-blocks and for-loops
  *          builtin.c -- several built-in functions (cd, exit, etc.)
+ *        utilities.c -- built-in echo, test, true, false and printf
+ *         cmdtable.c -- one table of the keywords and builtins, for lookups
+ *           cmdsub.c -- run $(...) and `...` and capture what they print
+ *            arena.c -- memory for the temporaries of one command
+ *            arith.c -- $((...)) arithmetic, compiled once per expression
  */
 
 /* INCLUDES */
 #include    <stdio.h>
 #include    <stdlib.h>
+#include    <stdarg.h>
+#include    <string.h>
 #include    <unistd.h>
 #include    <signal.h>
 #include    <sys/wait.h>
-#include    <stdbool.h>
 #include    "smsh.h"
 #include    "splitline.h"
 #include    "controlflow.h"
@@ -29,6 +41,11 @@
 #include    "process.h"
 #include    "builtin.h"
 #include    "flexstr.h"
+#include    "linereader.h"
+#include    "parser.h"
+#include    "lexer.h"
+#include    "jobs.h"
+#include    "arena.h"
 
 /* CONSTANTS */
 #define DFL_PROMPT  "> "
@@ -37,13 +54,12 @@
 static int last_exit = 0;
 static int shell_mode = INTERACTIVE;
 static int run_shell = 1;
+static pid_t shell_pid = 0;                 // not that of a forked copy
 
 /* INTERNAL FUNCTIONS */
-static void run_command(char *);
-static void execute_for();
 static void setup();
 static void io_setup();
-static FILE * open_script(char *);
+static LINEREADER * open_script(char *);
 
 /*
  *  main()
@@ -56,32 +72,32 @@ static FILE * open_script(char *);
  */
 int main(int ac, char ** av)
 {
-    FILE * source;
-    char *cmdline, *prompt;
+    LINEREADER * source;
+    struct node * tree;
+    char *prompt;
+    struct ar_mark mark;
 
     setup();    
     io_setup(&source, &prompt, ac, av);
     
     while ( run_shell )
     {
-        cmdline = next_cmd(prompt, source);     // get next line from source
-        
-        if(cmdline == NULL)                     // cmdline was EOF
+        // read the next command, or a whole if-block or loop
+        ar_mark(&mark);                         // its memory starts here
+        switch ( parse_next(source, prompt, &tree) )
         {
-            run_shell = safe_to_exit();         // check if processing if/for
-            clearerr(stdin);                    // clear the EOF
-            continue;
+            case P_OK:                          // run it, then discard it
+                exec_list(tree);
+                free_tree(tree);
+                break;
+            case P_ERROR:                       // syntax error, $? is 2
+                lr_clearerr(source);            // clear EOF if it hit one
+                break;
+            case P_EOF:                         // end of input
+                run_shell = 0;
+                break;
         }
-        
-        if( is_parsing_for() )                  // reading in a for_loop
-        {
-            if (load_for_loop(cmdline) == true) // when true
-                execute_for();                  // for_loop complete, execute
-
-            continue;                           // go to next cmdline
-        }
-        
-        run_command(cmdline);                   // all other commands/syntax
+        ar_release(&mark);                      // and all of it goes
     }
     
     return get_exit();
@@ -89,58 +105,46 @@ int main(int ac, char ** av)
 
 /*
  *  run_command()
- *  Purpose: Perform variable substitution and process() the command line
+ *  Purpose: Perform variable substitution and process() the command line.
+ *           Called by controlflow.c for each command in the tree. The
+ *           line is substituted and split in one pass by lex_line(), and
+ *           the whole command comes back as one block in the arena, which
+ *           is released when the command is over.
+ *    Input: cmdline, the line (need not be '\0'-terminated)
+ *           len, its length
  *   Return: None; exit status result is updated in file-scope variable in
  *           this function.
  */
-void run_command(char * cmdline)
+void run_command(char * cmdline, size_t len)
 {
-    char *subline = varsub(cmdline);
-    char **arglist;
-    int result = 0;
+    struct ar_mark mark;
 
-    if ( (arglist = splitline(subline)) != NULL )
-        result = process(arglist);
-    
-    if(result == -1)    // if command was a syntax error
-        result = 2;     // change 2 to for correct exit status
-
-    set_exit(result);   // update $? value
-    return; 
+    ar_mark(&mark);
+    run_args(lex_line(cmdline, len));
+    ar_release(&mark);          // the line, its tokens and arglist
+    return;
 }
 
 /*
- *  execute_for()
- *  Purpose: Iterate through a completed for_loop struct and execute cmds
- *   Return: None; this function loads the for loop struct, executes all
- *           commands, and updates $? value.
+ *  run_args()
+ *  Purpose: process() a command that is already split into words
+ *   Return: None; exit status result is updated in file-scope variable in
+ *           this function.
  */
-void execute_for()
+void run_args(char ** arglist)
 {
-    char **vars = get_for_vars();           // load in varvalues
-    char **cmds = get_for_commands();       // load in commands
-    char * name = get_for_name();           // load in varname for sub
-    char ** cmds_start;
+    struct ar_mark mark;
+    int result;
 
-    while(*vars)                            // for each varvalue
-    {
-        if (VLstore(name, *vars) == 1)      // set current var for sub
-        {
-            fprintf(stderr, "Problem updating the for variable. \n");
-            set_exit(2);
-            return;
-        }
-        
-        cmds_start = cmds;                  // reset to first command
-        
-        while(*cmds_start)                  // go through cmds for each var
-            run_command(*cmds_start++);     // execute
-            
-        vars++;                             // next variable
-    }
-    
-    free(name); 
-    return;
+    ar_mark(&mark);
+    result = process(arglist);
+    ar_release(&mark);  // what running it used (pipeline stages, ...)
+
+    if(result == -1)    // if command was a syntax error
+        result = 2;     // change 2 to for correct exit status
+
+    set_exit(result);   // update $? value
+    return; 
 }
 
 void setup()
@@ -151,16 +155,20 @@ void setup()
 {
     extern char **environ;
 
+    shell_pid = getpid();
     VLenviron2table(environ);
     signal(SIGINT,  SIG_IGN);
     signal(SIGQUIT, SIG_IGN);
+    jobs_init();
+    if ( getenv("SMSH_MEMSTATS") != NULL )
+        ar_memstats();
 }
 
 /*
  *  io_setup
  *  Purpose: Detect if smsh should be run in interactive, or script mode.
- *           Set 'FILE*' and 'prompt' accordingly.
- *    Input: fp, address of FILE * back in main
+ *           Set 'LINEREADER*' and 'prompt' accordingly.
+ *    Input: lrp, address of LINEREADER * back in main
  *           pp, address of pointer to "prompt" back in main
  *           args, number of command-line args
  *           av, command-line args
@@ -168,17 +176,17 @@ void setup()
  *   Errors: If a file is specified, but cannot be opened, open_script()
  *           will output a message and exit.
  */
-void io_setup(FILE ** fp, char ** pp, int args, char ** av)
+void io_setup(LINEREADER ** lrp, char ** pp, int args, char ** av)
 {
     if(args >= 2)
     {
-        *fp = open_script(av[1]);
+        *lrp = open_script(av[1]);              // block reads from the fd
         *pp = "";
         shell_mode = SCRIPTED;
     }
     else
     {
-        *fp = stdin;
+        *lrp = lr_fromfp(stdin);                // stdio, for the prompt
         *pp = DFL_PROMPT;
     }
     
@@ -188,19 +196,19 @@ void io_setup(FILE ** fp, char ** pp, int args, char ** av)
 /*
  *  open_script()
  *  Purpose: Open a file, and handle any errors it encounters.
- *   Return: Pointer to the file (shell script) it opened
+ *   Return: Line reader for the file (shell script) it opened
  */
-FILE * open_script(char * file)
+LINEREADER * open_script(char * file)
 {
-    FILE * fp = fopen(file, "r");
+    LINEREADER * lr = lr_open(file);
     
-    if(fp == NULL)
+    if(lr == NULL)
     {
         fprintf(stderr, "Can't open %s\n", file);
         exit(127);
     }
     
-    return fp;
+    return lr;
 }
 
 /*
@@ -235,6 +243,39 @@ int get_mode()
  */
 void fatal(char *s1, char *s2, int n)
 {
-    fprintf(stderr,"Error: %s,%s\n", s1, s2);
-    exit(n);
+    complain("Error: %s,%s\n", s1, s2);
+    shell_exit(n);
+}
+
+/*
+ *  shell_exit()
+ *  Purpose: End the shell, or the forked copy of it this is
+ *     Note: A copy (running $(...), a job or a pass of a loop) shares the
+ *           stdin FILE with the shell. exit() would move fd 0 back to where
+ *           the copy's stdio buffer thinks it is, so the shell would read
+ *           those lines again. A copy flushes stdout and calls _exit().
+ */
+void shell_exit(int status)
+{
+    if (getpid() == shell_pid)
+        exit(status);
+    fflush(stdout);
+    _exit(status);
+}
+
+/*
+ *  complain()
+ *  Purpose: Print an error message (printf-style) on stderr
+ *     Note: Builtins print to stdout through its buffer, so stdout is
+ *           flushed first: when both go to the same file, the message
+ *           then comes after the output that was printed before it.
+ */
+void complain(char *fmt, ...)
+{
+    va_list ap;
+
+    fflush(stdout);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
 }
@@ -8,11 +8,17 @@
 #ifndef	SMSH_H
 #define	SMSH_H
 
+#include    <stddef.h>
+
 enum mode { INTERACTIVE, SCRIPTED };
 
+void run_command(char *, size_t);
+void run_args(char **);
 int get_exit();
 void set_exit(int);
 int get_mode();
 void fatal(char *, char *, int);
+void shell_exit(int);
+void complain(char *, ...);
 
 #endif
\ No newline at end of file
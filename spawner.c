@@ -0,0 +1,170 @@
+/*
+ * ==========================
+ *   FILE: ./spawner.c
+ * ==========================
+ * Purpose: Start external programs without copying the shell.
+ *
+ * Outline: execute() used to fork() and then execvp() in the child. fork()
+ * has to copy the shell's page tables (and mark every page copy-on-write)
+ * only for the child to throw them all away a moment later in exec, and
+ * that cost grows with the shell's heap. sp_start() uses posix_spawn()
+ * instead; glibc runs the child on the parent's memory (CLONE_VM and
+ * CLONE_VFORK) until it execs, so nothing is copied. What the child used
+ * to do between fork() and exec is given to posix_spawn() up front:
+ *      - SIGINT and SIGQUIT go back to their defaults (the shell ignores
+ *        them, and ignored signals stay ignored across exec), except in
+ *        a background job (SP_ASYNC), which should not be stopped by a
+ *        ^C meant for the command in the foreground
+ *      - the environment is the one built by VLenviron()
+ *      - any of fds 0, 1 and 2 can be replaced by another open fd
+ * A file that is executable but is not a program (a script without a
+ * "#!" line) fails with ENOEXEC; as execvp() did, it is then run by
+ * /bin/sh, with its path as the first arg (see sh_argv()).
+ *
+ * If the system has no posix_spawn(), build with -DSMSH_FORK_SPAWN to
+ * get the old fork() and exec path behind the same interface.
+ *
+ * interface:
+ *      sp_start(path, argv, envp, fds, flags) -- start a program, return
+ *                                                its pid
+ */
+
+/* INCLUDES */
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <errno.h>
+#include    <unistd.h>
+#include    <signal.h>
+#include    "spawner.h"
+
+#ifndef SMSH_FORK_SPAWN
+#include    <spawn.h>
+#endif
+
+/* CONSTANTS */
+#define SP_SHELL    "/bin/sh"           // runs scripts with no "#!"
+
+/* FILE-SCOPE VARIABLES */
+#ifndef SMSH_FORK_SPAWN
+static posix_spawnattr_t attr;      // same for every child: set up once
+static posix_spawnattr_t bg_attr;   //  (and for every background child)
+static int attr_ready = 0;
+#endif
+
+/* INTERNAL FUNCTIONS */
+static char ** sh_argv(char *, char **);
+
+/*
+ *  sp_start()
+ *  Purpose: Start a program running
+ *    Input: path, the program file (found by pc_lookup(), not searched
+ *                 for here)
+ *           argv, its args
+ *           envp, the environment to give it
+ *           fds, NULL, or SP_NFDS fds to put on 0, 1 and 2 in the child
+ *                (-1 to leave one as it is)
+ *           flags, SP_ASYNC for a background job, or 0
+ *   Return: the pid of the child, or -1 with errno set if it could not
+ *           be started
+ *     Note: A file that gives ENOEXEC is started again as a script.
+ */
+#ifndef SMSH_FORK_SPAWN
+pid_t sp_start(char * path, char ** argv, char ** envp, int * fds, int flags)
+{
+    posix_spawn_file_actions_t acts, *actp = NULL;
+    char **shargv;
+    sigset_t dfl;
+    pid_t pid;
+    int i, err;
+
+    if (!attr_ready)
+    {
+        sigemptyset(&dfl);
+        sigaddset(&dfl, SIGINT);
+        sigaddset(&dfl, SIGQUIT);
+        posix_spawnattr_init(&attr);
+        posix_spawnattr_setsigdefault(&attr, &dfl);
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF);
+        posix_spawnattr_init(&bg_attr);         // signals left as they are
+        attr_ready = 1;
+    }
+
+    if (fds != NULL)
+    {
+        posix_spawn_file_actions_init(&acts);
+        for (i = 0; i < SP_NFDS; i++)
+            if (fds[i] != -1 && fds[i] != i)
+                posix_spawn_file_actions_adddup2(&acts, fds[i], i);
+        actp = &acts;
+    }
+
+    err = posix_spawn(&pid, path, actp,
+                      (flags & SP_ASYNC) ? &bg_attr : &attr, argv, envp);
+    if (err == ENOEXEC && (shargv = sh_argv(path, argv)) != NULL)
+    {
+        err = posix_spawn(&pid, SP_SHELL, actp,
+                          (flags & SP_ASYNC) ? &bg_attr : &attr, shargv, envp);
+        free(shargv);
+    }
+
+    if (actp != NULL)
+        posix_spawn_file_actions_destroy(actp);
+    if (err != 0)
+    {
+        errno = err;
+        return -1;
+    }
+    return pid;
+}
+
+#else
+
+pid_t sp_start(char * path, char ** argv, char ** envp, int * fds, int flags)
+{
+    extern char **environ;
+    pid_t pid;
+    int i;
+
+    if ( (pid = fork()) != 0 )              // parent, or fork() failed
+        return pid;
+
+    for (i = 0; fds != NULL && i < SP_NFDS; i++)
+        if (fds[i] != -1 && fds[i] != i)
+            dup2(fds[i], i);
+    environ = envp;
+    if (!(flags & SP_ASYNC))
+    {
+        signal(SIGINT, SIG_DFL);
+        signal(SIGQUIT, SIG_DFL);
+    }
+    execv(path, argv);
+    if (errno == ENOEXEC && (argv = sh_argv(path, argv)) != NULL)
+        execv(SP_SHELL, argv);
+    perror("cannot execute command");
+    _exit(1);                               // not exit(): see smsh.c
+}
+
+#endif
+
+/*
+ *  sh_argv()
+ *  Purpose: Make the args to run a script with no "#!" line by /bin/sh
+ *    Input: path, the script
+ *           argv, its args
+ *   Return: a malloc()ed argv: "sh", path, then argv[1] on; or NULL
+ */
+char ** sh_argv(char * path, char ** argv)
+{
+    char **av;
+    int n;
+
+    for (n = 0; argv[n] != NULL; n++)
+        ;
+    if ((av = malloc((n + 2) * sizeof(char *))) == NULL)
+        return NULL;
+    av[0] = "sh";
+    av[1] = path;
+    for ( ; n > 0; n--)                     // argv[1..], and the NULL
+        av[n + 1] = argv[n];
+    return av;
+}
@@ -0,0 +1,21 @@
+/*
+ * ==========================
+ *   FILE: ./spawner.h
+ * ==========================
+ * Purpose: Header file for spawner.c
+ */
+
+#ifndef	SPAWNER_H
+#define	SPAWNER_H
+
+#include    <sys/types.h>
+
+/* STANDARD FDS A CHILD CAN HAVE REDIRECTED */
+enum sp_fds { SP_IN, SP_OUT, SP_ERR, SP_NFDS };
+
+/* FLAGS FOR sp_start() */
+#define SP_ASYNC    1       // a background job: keep SIGINT, SIGQUIT ignored
+
+pid_t sp_start(char *path, char **argv, char **envp, int *fds, int flags);
+
+#endif
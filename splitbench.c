@@ -0,0 +1,220 @@
+/*
+ * ==========================
+ *   FILE: ./splitbench.c
+ * ==========================
+ * Purpose: Microbenchmark for splitline() and the scanners in tokscan.c.
+ *          Not part of the shell; build and run it with 'make bench'.
+ *
+ * Outline: Lines with many arguments are split over and over by the
+ * original byte-at-a-time splitline() (copied below as old_splitline())
+ * and by the current one, once with each scanner this CPU can run. The
+ * results are checked against each other before anything is timed. Since
+ * both versions spend most of their time copying tokens, the scan on its
+ * own (finding the tokens, no copies) is timed as well.
+ *
+ * usage: ./splitbench [reps]
+ */
+
+/* INCLUDES */
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <time.h>
+#include    "splitline.h"
+#include    "flexstr.h"
+#include    "tokscan.h"
+
+/* CONSTANTS */
+#define DFL_REPS    2000
+
+/* INTERNAL FUNCTIONS */
+static char ** old_splitline(char *);
+static int old_scan(char *);
+static char * make_line(int ntok, int maxlen);
+static int same_list(char **, char **);
+static double now();
+static void run(char *, char *, int);
+
+/*
+ *  fatal() -- splitline.c calls this from emalloc(); smsh.c is not linked
+ */
+void fatal(char *s1, char *s2, int n)
+{
+    fprintf(stderr, "Error: %s,%s\n", s1, s2);
+    exit(n);
+}
+
+int main(int ac, char ** av)
+{
+    int reps = (ac > 1 ? atoi(av[1]) : DFL_REPS);
+
+    srand(28);
+    run("short args ", make_line(2000, 8), reps);
+    run("long args  ", make_line(500, 120), reps);
+    run("few, spaced", make_line(20, 4), reps * 50);
+    return 0;
+}
+
+/*
+ *  run()
+ *  Purpose: Check and time every splitter on one line
+ */
+void run(char * label, char * line, int reps)
+{
+    static int impls[] = { TS_SCALAR, TS_SSE2, TS_AVX2 };
+    static struct tokspan *spans = NULL;
+    static size_t nslots = 0;
+    char **want = old_splitline(line), **got;
+    size_t i, len = strlen(line);
+    double t0, t1, base, scanbase;
+    int r, ntok;
+    volatile int sink = 0;                  // keeps the scans from going away
+
+    printf("%s: %zu bytes, %d reps        splitline()       scan only\n",
+           label, len, reps);
+
+    t0 = now();
+    for (r = 0; r < reps; r++)
+        freelist(old_splitline(line));
+    base = now() - t0;
+    t0 = now();
+    for (r = 0; r < reps; r++)
+        sink += old_scan(line);
+    ntok = old_scan(line);
+    scanbase = now() - t0;
+    printf("    %-12s %8.3f ms          %8.3f ms\n", "original",
+           base * 1000, scanbase * 1000);
+
+    for (i = 0; i < sizeof(impls) / sizeof(impls[0]); i++)
+    {
+        if ( !ts_setimpl(impls[i]) )
+            continue;
+
+        got = splitline(line);
+        if ( !same_list(want, got) ||
+             ts_split(line, len, &spans, &nslots) != ntok )
+        {
+            printf("    %-12s WRONG RESULT\n", ts_implname());
+            exit(1);
+        }
+        freelist(got);
+
+        t0 = now();
+        for (r = 0; r < reps; r++)
+            freelist(splitline(line));
+        t0 = now() - t0;
+        t1 = now();
+        for (r = 0; r < reps; r++)
+            sink += ts_split(line, len, &spans, &nslots);
+        t1 = now() - t1;
+        printf("    %-12s %8.3f ms (%.2fx) %8.3f ms (%.2fx)\n", ts_implname(),
+               t0 * 1000, base / t0, t1 * 1000, scanbase / t1);
+    }
+
+    freelist(want);
+    free(line);
+}
+
+/*
+ *  old_splitline()
+ *  Purpose: splitline() as it was before tokscan.c, for comparison
+ */
+#define	is_delim(x) ((x)==' '||(x)=='\t')
+
+char ** old_splitline(char *line)
+{
+	int	start;
+	int	len;
+	int	i=0;
+	FLEXLIST strings;
+	char	**parts;
+
+	fl_init(&strings,0);
+
+	while( line[i] != '\0' )
+	{
+		while ( is_delim(line[i]) )	/* skip leading spaces	*/
+			i++;
+		if ( line[i] == '\0' )		/* end of string? 	*/
+			break;			/* yes, get out		*/
+
+		/* mark start, then find end of word */
+		start = i++;
+		len   = 1;
+		while ( line[i] != '\0' && !(is_delim(line[i])) )
+			i++, len++;
+		fl_appendd(&strings, newstr(&line[start], len));
+	}
+	parts = fl_getlist(&strings);
+	fl_free(&strings);
+	return parts;
+}
+
+/*
+ *  old_scan()
+ *  Purpose: The token-finding loop of old_splitline(), without the copies
+ *   Return: the number of tokens
+ */
+int old_scan(char *line)
+{
+	int	i=0, n=0;
+
+	while( line[i] != '\0' )
+	{
+		while ( is_delim(line[i]) )
+			i++;
+		if ( line[i] == '\0' )
+			break;
+		i++;
+		while ( line[i] != '\0' && !(is_delim(line[i])) )
+			i++;
+		n++;
+	}
+	return n;
+}
+
+/*
+ *  make_line()
+ *  Purpose: Build a line of ntok random words of 1..maxlen chars, with
+ *           runs of blanks and tabs between them
+ */
+char * make_line(int ntok, int maxlen)
+{
+    FLEXSTR s;
+    char *line;
+    int t, n;
+
+    fs_init(&s, 0);
+    for (t = 0; t < ntok; t++)
+    {
+        for (n = 1 + rand() % 3; n > 0; n--)
+            fs_addch(&s, (rand() % 4 == 0 ? '\t' : ' '));
+        for (n = 1 + rand() % maxlen; n > 0; n--)
+            fs_addch(&s, 'a' + rand() % 26);
+    }
+    line = fs_getstr(&s);
+    fs_free(&s);
+    return line;
+}
+
+/*
+ *  same_list() -- 1 if two NULL-terminated lists hold the same strings
+ */
+int same_list(char ** a, char ** b)
+{
+    for ( ; *a && *b; a++, b++)
+        if (strcmp(*a, *b) != 0)
+            return 0;
+    return *a == NULL && *b == NULL;
+}
+
+/*
+ *  now() -- a monotonic clock, in seconds
+ */
+double now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
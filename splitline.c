@@ -2,6 +2,7 @@
  *    
  *    char *next_cmd(char *prompt, FILE *fp) - get next command
  *    char **splitline(char *str);           - parse a string
+ *    char **splitline_n(char *str, size_t len) - parse len chars of str
  */
 
 #include	<stdio.h>
@@ -10,6 +11,7 @@
 #include	"splitline.h"
 #include	"smsh.h"
 #include	"flexstr.h"
+#include	"tokscan.h"
 
 char * next_cmd(char *prompt, FILE *fp)
 /*
@@ -19,6 +21,7 @@ char * next_cmd(char *prompt, FILE *fp)
  *          calls fatal from emalloc()
  *   notes: allocates space in BUFSIZ chunks.  
  *    hist: 2019-04-20: removed memory leak (did not call fs_free on FS.v2)
+ *          later: take the FLEXSTR's string instead of copying it
  */
 {
 	int	c;				/* input char		*/
@@ -41,16 +44,13 @@ char * next_cmd(char *prompt, FILE *fp)
 	if ( c == EOF && pos == 0 )		/* EOF and no input	*/
 		return NULL;			/* say so		*/
 	fs_addch(&s, '\0');			/* terminate string	*/
-	retval = fs_getstr(&s);			/* get copy of string	*/
-	fs_free(&s);				/* release fs memory	*/
+	retval = fs_detach(&s, 0);		/* take it, no copy	*/
 	return retval;
 }
 
 /**
  **	splitline ( parse a line into an array of strings )
  **/
-#define	is_delim(x) ((x)==' '||(x)=='\t')
-
 char ** splitline(char *line)
 /*
  * purpose: split a line into array of white-space separated tokens
@@ -62,35 +62,38 @@ char ** splitline(char *line)
  *    note: strtok() could work, but we may want to add quotes later
  */
 {
-	char	*newstr();
-	int	start;
-	int	len;
-	int	i=0;
+	if ( line == NULL )			/* handle special case	*/
+		return NULL;
+	return splitline_n(line, strlen(line));
+}
+
+char ** splitline_n(char *line, size_t n)
+/*
+ * purpose: splitline() for the first n chars of line, which need not be
+ *          '\0'-terminated (e.g. a slice of a mapped script)
+ * returns: same as splitline()
+ *  action: ts_split() finds all the tokens first (many bytes at a time,
+ *          see tokscan.c), then the list is sized once and filled in.
+ *          The list is handed over with fl_steal(), so each token is
+ *          copied out of the line once and never again.
+ */
+{
+	static struct tokspan *spans = NULL;	/* reused between calls	*/
+	static size_t	nslots = 0;
+	int	ntok;
+	int	i;
 	FLEXLIST strings;
-	char	**parts;
 
 	if ( line == NULL )			/* handle special case	*/
 		return NULL;
 
-	fl_init(&strings,0);
+	ntok = ts_split(line, n, &spans, &nslots);
 
-	while( line[i] != '\0' )
-	{
-		while ( is_delim(line[i]) )	/* skip leading spaces	*/
-			i++;
-		if ( line[i] == '\0' )		/* end of string? 	*/
-			break;			/* yes, get out		*/
-
-		/* mark start, then find end of word */
-		start = i++;
-		len   = 1;
-		while ( line[i] != '\0' && !(is_delim(line[i])) )
-			i++, len++;
-		fl_appendd(&strings, newstr(&line[start], len));
-	}
-	parts = fl_getlist(&strings);
-	fl_free(&strings);
-	return parts;
+	fl_init(&strings, ntok + 1);		/* one allocation	*/
+	for ( i = 0 ; i < ntok ; i++ )
+		fl_appendd(&strings, newstr(&line[spans[i].ts_start],
+					    spans[i].ts_len));
+	return fl_steal(&strings);		/* no deep copy		*/
 }
 
 /*
@@ -1,11 +1,15 @@
 #ifndef	SPLITLINE_H
 #define	SPLITLINE_H
 
+#include	<stddef.h>
+
 #define	YES	1
 #define	NO	0
 
 char	*next_cmd();
 char	**splitline(char *);
+char	**splitline_n(char *, size_t);
+char	*newstr(char *, int);
 void	freelist(char **);
 void	*emalloc(size_t);
 void	*erealloc(void *, size_t);
@@ -0,0 +1,271 @@
+/*
+ * ==========================
+ *   FILE: ./template.c
+ * ==========================
+ * Purpose: Compile command lines that run over and over (the bodies of
+ *          loops) so each run only has to fill in variable values.
+ *
+ * Outline: lex_line() rescans and re-copies a command line every time it
+ * runs. For a line in a loop body, all of that work is the same on every
+ * pass except for the values of the variables. tm_compile() does the scan
+ * once, following exactly the rules of lex_line() (see lexer.c):
+ *      - a '#' after a blank (or at the start) begins a comment
+ *      - '\' takes the next char literally (a blank still splits words)
+ *      - '$' is followed by a variable name, '$$', '$?' or '$!'
+ *      - '$(command)' and '`command`' are command substitutions; the
+ *        command is kept as text and run each time (see cmdsub.c)
+ *      - '$((expression))' is arithmetic; the expression is compiled the
+ *        first time it is expanded and evaluated each time (see arith.c)
+ *      - blanks separate words
+ * and records the result as a list of operations (see template.h).
+ * tm_expand() then builds the argv by walking that list with the same
+ * word builder lex_line() uses, so variable values are split at blanks
+ * the same way. The text and argv arrays are kept in the template and
+ * reused by the next expansion.
+ *
+ * interface:
+ *      tm_compile(line, len)    -- compile a raw command line
+ *      tm_expand(tm)            -- build argv for the current variables
+ *      tm_free(tm)              -- release a template
+ */
+
+/* INCLUDES */
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <ctype.h>
+#include    <unistd.h>
+#include    "smsh.h"
+#include    "splitline.h"
+#include    "varlib.h"
+#include    "flexstr.h"
+#include    "jobs.h"
+#include    "cmdsub.h"
+#include    "arith.h"
+#include    "lexer.h"
+#include    "template.h"
+
+/* CONSTANTS */
+#define is_blank(x) ((x)==' ' || (x)=='\t')
+#define is_delim(x) ((x)==' ' || (x)=='\t' || (x)=='\0')
+
+/* INTERNAL FUNCTIONS */
+static void add_op(struct template *, int, char *, size_t, int *);
+static void flush_lit(struct template *, FLEXSTR *, int *);
+
+/*
+ *  tm_compile()
+ *  Purpose: Compile a raw command line into a template
+ *    Input: line, the raw line (need not be '\0'-terminated)
+ *           len, its length
+ *   Return: the new template
+ *   Method: Literal chars are collected in a FLEXSTR and stored as one
+ *           T_LIT when a break, variable or the end of the line is reached.
+ *           Variable names are read the way lex_var() reads them: the
+ *           first char is always taken (so '$$' and '$?' work), then any
+ *           alpha-numeric or underscore chars after it.
+ */
+struct template * tm_compile(char * line, size_t len)
+{
+    struct template *tm = emalloc(sizeof(struct template));
+    char *cp = line, *end = line + len, *name;
+    char c, prev = '\0';                    // line start counts as delim
+    int nslots = 0;
+    FLEXSTR lit, cmd;
+
+    tm->tm_ops = NULL;
+    tm->tm_nops = 0;
+    tm->tm_argv = NULL;
+    tm->tm_nslots = 0;
+    wb_init(&tm->tm_words);
+    fs_init(&lit, 0);
+
+    while (cp < end)
+    {
+        c = *cp;
+        if (c == '#' && is_delim(prev))                 // comment
+            break;
+        else if (c == '\\' && cp + 1 < end)             // escape char
+        {
+            cp++;
+            if (is_blank(*cp))                          // still splits
+            {
+                flush_lit(tm, &lit, &nslots);
+                add_op(tm, T_BREAK, NULL, 0, &nslots);
+            }
+            else
+                fs_addch(&lit, *cp);
+        }
+        else if (c == '$' && cp + 2 < end && cp[1] == '(' && cp[2] == '(')
+        {                                               // arithmetic
+            flush_lit(tm, &lit, &nslots);
+            name = ax_scan(cp + 3, end);
+            add_op(tm, T_ARITH, newstr(cp + 3, name - (cp + 3)),
+                   name - (cp + 3), &nslots);
+            cp = name;
+            prev = c;
+            continue;                       // cp is past its end already
+        }
+        else if ((c == '$' && cp + 1 < end && cp[1] == '(') || c == '`')
+        {                                               // command
+            flush_lit(tm, &lit, &nslots);
+            fs_init(&cmd, 0);
+            cp = cs_scan(cp + (c == '`' ? 1 : 2), end, c == '`' ? '`' : ')',
+                         &cmd);
+            add_op(tm, T_CMDSUB, newstr(fs_data(&cmd), cmd.fs_used),
+                   cmd.fs_used, &nslots);
+            fs_free(&cmd);
+            prev = c;
+            continue;                       // cp is past its end already
+        }
+        else if (c == '$')                              // variable
+        {
+            flush_lit(tm, &lit, &nslots);
+            name = ++cp;
+            if (cp < end)                   // '$' at the end: empty name
+                cp++;
+            while (cp < end && (isalnum(*cp) || *cp == '_'))
+                cp++;
+
+            if (cp - name == 1 && *name == '$')
+                add_op(tm, T_PID, NULL, 0, &nslots);
+            else if (cp - name == 1 && *name == '?')
+                add_op(tm, T_STATUS, NULL, 0, &nslots);
+            else if (cp - name == 1 && *name == '!')
+                add_op(tm, T_LASTBG, NULL, 0, &nslots);
+            else if (cp > name)
+                add_op(tm, T_VAR, newstr(name, cp - name), cp - name, &nslots);
+
+            prev = c;
+            continue;                       // cp is past the name already
+        }
+        else if (c == '|' || c == '&')                  // operator
+        {
+            flush_lit(tm, &lit, &nslots);
+            add_op(tm, T_OP, NULL, lx_scanop(&cp, end), &nslots);
+            c = ' ';                        // a '#' after it is a comment
+        }
+        else if (is_blank(c))                           // word break
+        {
+            flush_lit(tm, &lit, &nslots);
+            add_op(tm, T_BREAK, NULL, 0, &nslots);
+        }
+        else                                            // regular char
+            fs_addch(&lit, c);
+
+        prev = c;
+        cp++;
+    }
+
+    flush_lit(tm, &lit, &nslots);
+    fs_free(&lit);
+    return tm;
+}
+
+/*
+ *  add_op()
+ *  Purpose: Append an operation to the template, growing the array
+ */
+void add_op(struct template * tm, int op, char * text, size_t len, int * nslots)
+{
+    if (tm->tm_nops == *nslots)
+    {
+        *nslots = (*nslots == 0 ? 8 : 2 * *nslots);
+        tm->tm_ops = erealloc(tm->tm_ops, *nslots * sizeof(struct tm_op));
+    }
+
+    tm->tm_ops[tm->tm_nops].op = op;
+    tm->tm_ops[tm->tm_nops].text = text;
+    tm->tm_ops[tm->tm_nops].len = len;
+    tm->tm_ops[tm->tm_nops].expr = NULL;
+    tm->tm_nops++;
+}
+
+/*
+ *  flush_lit()
+ *  Purpose: Store the literal chars collected so far as a T_LIT
+ */
+void flush_lit(struct template * tm, FLEXSTR * lit, int * nslots)
+{
+    if (lit->fs_used == 0)
+        return;
+
+    add_op(tm, T_LIT, newstr(fs_data(lit), lit->fs_used), lit->fs_used, nslots);
+    lit->fs_used = 0;                       // keep the space, drop the text
+}
+
+/*
+ *  tm_expand()
+ *  Purpose: Build the argv for a template with the current variable values
+ *   Return: NULL-terminated argv. It and its strings belong to the template
+ *           and are only good until the template is expanded again.
+ */
+char ** tm_expand(struct template * tm)
+{
+    struct wordbuf *wb = &tm->tm_words;
+    struct tm_op *op = tm->tm_ops;
+    struct tm_op *end = op + tm->tm_nops;
+    char *val;
+
+    wb_reset(wb);                           // reuse the space from last time
+    cs_begin();
+
+    for ( ; op < end; op++)
+    {
+        if (op->op == T_LIT)
+            wb_addtext(wb, op->text, op->len);
+        else if (op->op == T_VAR)
+            wb_addfield(wb, VLlookupn(op->text, op->len));
+        else if (op->op == T_PID)
+            wb_addnum(wb, getpid());
+        else if (op->op == T_STATUS)
+            wb_addnum(wb, get_exit());
+        else if (op->op == T_LASTBG)
+        {
+            if (job_lastpid() != 0)
+                wb_addnum(wb, job_lastpid());
+        }
+        else if (op->op == T_CMDSUB)
+            wb_addfield(wb, cs_run(op->text, op->len));
+        else if (op->op == T_ARITH)
+        {
+            if (op->expr == NULL)           // (again, if it did not compile)
+                op->expr = ax_compile(op->text, op->len);
+            if ((val = ax_value(op->expr)) != NULL)
+                wb_addtext(wb, val, strlen(val));
+        }
+        else if (op->op == T_OP)
+            wb_addop(wb, op->len);
+        else
+            wb_endword(wb);
+    }
+    wb_endword(wb);
+
+    if (tm->tm_nslots < wb->wb_nwords + 1)  // room for the NULL
+    {
+        tm->tm_nslots = wb->wb_nslots + 1;
+        tm->tm_argv = erealloc(tm->tm_argv, tm->tm_nslots * sizeof(char *));
+    }
+
+    wb_fillargv(wb, tm->tm_argv, fs_data(&wb->wb_text));   // words in place
+    return tm->tm_argv;
+}
+
+/*
+ *  tm_free()
+ *  Purpose: Release a template and everything in it
+ */
+void tm_free(struct template * tm)
+{
+    int i;
+
+    if (tm == NULL)
+        return;
+
+    for (i = 0; i < tm->tm_nops; i++)
+        free(tm->tm_ops[i].text);
+    free(tm->tm_ops);
+    wb_free(&tm->tm_words);
+    free(tm->tm_argv);
+    free(tm);
+}
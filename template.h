@@ -0,0 +1,52 @@
+/*
+ * ==========================
+ *   FILE: ./template.h
+ * ==========================
+ * Purpose: Header file for template.c
+ */
+
+#ifndef	TEMPLATE_H
+#define	TEMPLATE_H
+
+#include    <stddef.h>
+#include    "lexer.h"
+#include    "arith.h"
+
+/* TEMPLATE OPERATIONS */
+enum tm_ops { T_LIT,        // append literal text to the current word
+              T_VAR,        // append the value of a variable, split at blanks
+              T_PID,        // append $$
+              T_STATUS,     // append $?
+              T_LASTBG,     // append $!
+              T_CMDSUB,     // append a command's output, split at blanks
+              T_ARITH,      // append the value of an expression
+              T_OP,         // add an operator (len is its OP_ code)
+              T_BREAK };    // end the current word (if any)
+
+struct tm_op {
+    int     op;             // one of tm_ops
+    char *  text;           // T_LIT: the text; T_VAR: the name ('\0'-term);
+                            //  T_CMDSUB: the command; T_ARITH: the
+                            //  expression, with its "))"
+    size_t  len;            // length of text; T_OP: which operator
+    struct arith *expr;     // T_ARITH: compiled (owned by arith.c), or NULL
+};
+
+/*
+ * A command line compiled once: comments are gone, escapes are resolved,
+ * and what is left is a list of literal pieces, variable references and
+ * word breaks. The words and argv built from it are kept between runs.
+ */
+struct template {
+    struct tm_op *  tm_ops;         // the compiled line
+    int             tm_nops;
+    struct wordbuf  tm_words;       // the expanded words (see lexer.h)
+    char **         tm_argv;        // NULL-terminated argv built from them
+    int             tm_nslots;      // room in tm_argv
+};
+
+struct template * tm_compile(char *line, size_t len);
+char ** tm_expand(struct template *tm);
+void tm_free(struct template *tm);
+
+#endif
@@ -0,0 +1,45 @@
+# && and || lists
+true && echo and runs
+false && echo never
+false || echo or runs
+true || echo never
+echo status $?
+false && echo never || echo fallback
+true && false || echo after false
+true || false && echo left to right
+false && echo never
+echo kept $?
+# Only the commands reached are run, and each sees the status so far
+x=0
+true && x=1 || x=2
+echo x is $x
+false && x=3 || x=4
+echo x is $x
+[ $x -eq 4 ] && echo test in a list
+# Programs, pipelines and substitutions in a list
+ls -d / || echo unused
+seq 1 3 | wc -l && echo pipeline ok
+nosuchcommand_xyz || echo not found gives $?
+false || v=$(echo late)
+echo v is $v
+false && w=$(echo never)
+echo w is $w
+false && echo $(mkdir /tmp/test_andor.$$)
+[ -d /tmp/test_andor.$$ ] && echo substitution ran || echo substitution skipped
+[ -d /tmp/test_andor.$$ ] && rmdir /tmp/test_andor.$$
+# In loops and if
+for i in 1 2 3 4
+do
+    [ $i -eq 2 ] && echo two || echo not two
+done
+n=0
+while [ $n -lt 3 ] && true
+do
+    n=$((n + 1))
+done
+echo n is $n
+if false || true
+then
+    echo if list
+fi
+echo done
@@ -0,0 +1,46 @@
+# Arithmetic expansion, $((...))
+echo $((1 + 2)) $((7 - 10)) $((6 * 7)) $((17 / 5)) $((17 % 5))
+echo $((-17 / 5)) $((-17 % 5)) $((2 + 3 * 4)) $(((2 + 3) * 4))
+echo $((010)) $((0x1f)) $((0X10 + 1))
+echo $((1 << 10)) $((1024 >> 3)) $((5 & 3)) $((5 | 3)) $((5 ^ 3)) $((~0))
+echo $((3 < 4)) $((3 <= 2)) $((3 > 2)) $((3 >= 4)) $((3 == 3)) $((3 != 3))
+echo $((!0)) $((!5)) $((-(-4))) $((+4)) $((- - 4))
+echo $((1 && 2)) $((1 && 0)) $((0 || 0)) $((0 || 7))
+echo $((1 ? 10 : 20)) $((0 ? 10 : 20)) $((0 ? 1 : 0 ? 2 : 3))
+# Variables, with or without $, and unset ones are 0
+a=6
+b=7
+echo $((a * b)) $(($a * $b)) $((nosuchvar + 1))
+e=
+echo $((e + 5))
+# Assignments change the variable
+echo $((c = 5)) $c
+echo $((c += 2)) $((c -= 1)) $((c *= 3)) $((c /= 2)) $((c %= 5)) $c
+echo $((c <<= 4)) $((c >>= 2)) $((c |= 1)) $((c &= 13)) $((c ^= 6)) $c
+echo $((x = y = 3)) $x $y
+# Only the branch taken is evaluated
+z=1
+echo $((0 && (z = 2))) $((1 || (z = 3))) $((1 ? z : (z = 4))) $z
+# $? inside, and an expansion in the middle of a word
+false
+echo $(($? + 1))
+echo x$((20 + 22))y
+# Wrapping instead of overflowing
+echo $((9223372036854775807 + 1))
+# A counter in a loop, compiled once
+i=0
+s=0
+while [ $i -lt 100 ]
+do
+    s=$((s + i * i))
+    i=$((i + 1))
+done
+echo $i $s
+for n in 1 2 3
+do
+    echo $((n * n)) $(($n + n))
+done
+echo done
+# A syntax error ends a script
+echo $((1 +))
+echo not reached
@@ -0,0 +1,58 @@
+# Keywords and builtins, found through one table (cmdtable.c)
+echo start
+true
+echo true gives $?
+false
+echo false gives $?
+test 3 -lt 5
+echo test gives $?
+[ abc = abd ]
+echo bracket gives $?
+printf %s-%d word 42
+echo
+x=1
+export x
+if [ $x -eq 1 ]
+then
+    echo if works
+else
+    echo if is broken
+fi
+for w in one two three
+do
+    echo for $w
+done
+cd /
+pwd
+cd /tmp
+pwd
+nosuchcommand_xyz
+echo not found gives $?
+# A name that only looks like a builtin is a program
+ech hello
+echo status $?
+# Pipelines
+echo a b c | wc -w
+seq 10 -1 1 | sort -n | head -3
+seq 1 5 | tr -d 4 | wc -l
+true | false
+echo pipeline gives $?
+false | true
+echo pipeline gives $?
+# A builtin in a pipeline
+echo x y | wc -c
+printf %s abc | wc -c
+test 1 -eq 1 | cat
+echo test in a pipeline gives $?
+# A builtin stage changes nothing in the shell, and exit only ends it
+echo hi | exit 3
+echo after exit $?
+cd / | true
+pwd
+y=5 | true
+echo y is $y
+true | cd / | cat
+pwd
+seq 1 3 | exit | cat
+echo still here $?
+echo done
@@ -0,0 +1,38 @@
+# Command substitution: $(...) and backticks
+echo start
+echo $(echo hello)
+echo `echo backticks`
+echo -$(printf abc)-
+echo x$(echo a b c)y
+for w in $(seq 1 3)
+do
+    echo word $w
+done
+echo $(echo $(echo nested))
+echo `echo \`echo nested backticks\``
+echo lines: $(seq 1 100 | wc -l)
+# Trailing newlines are taken off
+echo -$(seq 1 3)-
+# An assignment keeps the whole output
+m=$(echo a b c)
+echo $m
+n=`seq 1 3`
+echo $n
+# The status of the command becomes $?
+x=$(false)
+echo false gives $?
+x=$(exit 3)
+echo exit gives $?
+# What the command changes is lost
+d=$(cd / && pwd)
+echo $d
+pwd
+v=1
+w=$(v=2)
+echo $v
+# Builtins and programs both work, and in loops
+for k in a b c
+do
+    echo $k=$(echo $k$k) `printf %s- $k`
+done
+echo done
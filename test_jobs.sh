@@ -0,0 +1,36 @@
+# Background jobs, $! and wait
+false &
+p=$!
+sleep 0.2
+true &
+q=$!
+wait $p
+echo first job gave $?
+wait $q
+echo second job gave $?
+# A finished job is kept for wait, however many start after it
+ls /nonexistent_dir_for_test &
+r=$!
+sleep 0.2
+for i in 1 2 3 4 5 6 7 8 9 10
+do
+    true &
+done
+wait $r
+echo ls gave $?
+# A builtin, a pipeline and an and-or list as a job
+test 2 -lt 1 &
+t=$!
+wait $t
+echo test gave $?
+seq 1 3 | grep 4 &
+u=$!
+wait $u
+echo pipeline gave $?
+true && false &
+v=$!
+wait $v
+echo list gave $?
+wait
+echo wait gave $?
+echo done
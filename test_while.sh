@@ -0,0 +1,63 @@
+# while and until loops
+i=0
+while [ $i -lt 5 ]
+do
+    echo while $i
+    i=`expr $i + 1`
+done
+echo after while $i
+until test $i -eq 0
+do
+    echo until $i
+    i=$((i - 1))
+done
+echo after until $i
+# A condition that is false at once runs nothing
+while false
+do
+    echo never
+done
+echo status $?
+until true
+do
+    echo never
+done
+# Loops inside loops, and if inside them
+for a in x y
+do
+    n=0
+    while [ $n -lt 3 ]
+    do
+        if [ $n -eq 1 ]
+        then
+            echo $a one
+        else
+            echo $a $n
+        fi
+        n=$((n + 1))
+    done
+done
+# A program as the condition, and a status from the body
+k=3
+while expr $k \> 0
+do
+    k=$((k - 1))
+done
+echo k is $k
+# The condition can use a substitution; it is run again each time
+j=0
+until [ $(expr $j \* $j) -gt 20 ]
+do
+    j=$((j + 1))
+done
+echo j is $j
+# A longer loop, run from its compiled form after the first pass
+t=0
+c=0
+while [ $c -lt 200 ]
+do
+    t=$((t + c))
+    c=$((c + 1))
+done
+echo total $t
+echo done
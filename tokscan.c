@@ -0,0 +1,395 @@
+/*
+ * ==========================
+ *   FILE: ./tokscan.c
+ * ==========================
+ * Purpose: Find the white-space separated tokens of a line, many bytes at
+ *          a time.
+ *
+ * Outline: splitline() used to walk a line one byte at a time with its
+ * is_delim() macro. ts_split() finds the same tokens (runs of anything but
+ * ' ' and '\t') and returns their offsets and lengths in one array. On x86
+ * it loads 16 (SSE2) or 32 (AVX2) bytes at once, compares them all against
+ * ' ' and '\t', and turns the result into a bit mask with one bit per byte.
+ * Token starts and ends are the 0->1 and 1->0 steps in that mask; they are
+ * found with a shift and an and-not, and visited with count-trailing-zeros,
+ * so the cost is per token rather than per byte. The last partial block
+ * is copied into a buffer padded with blanks, so nothing past the end of
+ * the line is ever read.
+ *
+ * ts_plain() uses the same loads for the lexer (see lexer.c): it finds how
+ * far a line goes before the next char the lexer has to look at -- a
+ * blank, '$', '\', '#', '|', '&' or '`' -- so plain text is copied a run at
+ * a time.
+ *
+ * The scanner is picked the first time it is needed: AVX2 if the CPU
+ * has it, else SSE2 (always there on x86-64), else a plain byte loop.
+ *
+ * interface:
+ *      ts_split(line, len, &spans, &nslots) -- find the tokens
+ *      ts_plain(str, len)                   -- length of the plain run
+ *      ts_setimpl(impl)                     -- force a scanner (benchmarks)
+ *      ts_implname()                        -- name of the scanner in use
+ */
+
+/* INCLUDES */
+#include    <stdio.h>
+#include    <string.h>
+#include    <stdint.h>
+#include    "splitline.h"
+#include    "tokscan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TS_X86  1
+#include    <immintrin.h>
+#endif
+
+#define is_delim(x) ((x)==' '||(x)=='\t')
+#define is_special(x) ((x)==' '||(x)=='\t'||(x)=='$'||(x)=='\\'||(x)=='#'||\
+                       (x)=='|'||(x)=='&'||(x)=='`')
+
+/* FILE-SCOPE VARIABLES */
+static int (*scanner)(char *, size_t, struct tokspan *) = NULL;
+static size_t (*plainer)(char *, size_t) = NULL;
+static int impl_in_use = TS_SCALAR;
+static char *impl_names[] = { "scalar", "sse2", "avx2" };
+
+/* INTERNAL FUNCTIONS */
+static void pick_scanner();
+static int scan_scalar(char *, size_t, struct tokspan *);
+static size_t plain_scalar(char *, size_t);
+#ifdef TS_X86
+static int scan_sse2(char *, size_t, struct tokspan *);
+static int scan_avx2(char *, size_t, struct tokspan *);
+static size_t plain_sse2(char *, size_t);
+static size_t plain_avx2(char *, size_t);
+#endif
+
+/*
+ *  ts_split()
+ *  Purpose: Find the tokens in a line
+ *    Input: line, the text (need not be '\0'-terminated)
+ *           len, its length
+ *           spansp, nslotsp, a caller-owned array of spans and its size;
+ *                   it is grown as needed and can be reused across calls
+ *   Return: the number of tokens, whose spans are in (*spansp)[0..n-1]
+ *     Note: A line of len bytes has at most (len + 1) / 2 tokens, so the
+ *           array is sized once up front and the scanners never check it.
+ */
+int ts_split(char * line, size_t len, struct tokspan ** spansp,
+             size_t * nslotsp)
+{
+    size_t most = len / 2 + 1;
+
+    if (*nslotsp < most)
+    {
+        *spansp = erealloc(*spansp, most * sizeof(struct tokspan));
+        *nslotsp = most;
+    }
+
+    if (scanner == NULL)
+        pick_scanner();
+    return scanner(line, len, *spansp);
+}
+
+/*
+ *  ts_plain()
+ *  Purpose: Find the run of plain text at the start of str
+ *    Input: str, the text (need not be '\0'-terminated)
+ *           len, its length
+ *   Return: the number of chars before the first blank, '$', '\', '#',
+ *           '|', '&' or '`', or len if there is none
+ */
+size_t ts_plain(char * str, size_t len)
+{
+    if (plainer == NULL)
+        pick_scanner();
+    return plainer(str, len);
+}
+
+/*
+ *  ts_setimpl()
+ *  Purpose: Use a particular scanner (for benchmarks and testing)
+ *   Return: 1 if that scanner can run on this machine, 0 if not
+ */
+int ts_setimpl(int impl)
+{
+#ifdef TS_X86
+    if (impl == TS_AVX2 && __builtin_cpu_supports("avx2"))
+    {
+        scanner = scan_avx2;
+        plainer = plain_avx2;
+    }
+    else if (impl == TS_SSE2)
+    {
+        scanner = scan_sse2;
+        plainer = plain_sse2;
+    }
+    else
+#endif
+    if (impl == TS_SCALAR)
+    {
+        scanner = scan_scalar;
+        plainer = plain_scalar;
+    }
+    else
+        return 0;
+
+    impl_in_use = impl;
+    return 1;
+}
+
+/*
+ *  ts_implname() -- name of the scanner in use
+ */
+char * ts_implname()
+{
+    if (scanner == NULL)
+        pick_scanner();
+    return impl_names[impl_in_use];
+}
+
+/*
+ *  pick_scanner()
+ *  Purpose: Choose the fastest scanner this CPU can run
+ */
+void pick_scanner()
+{
+    if (ts_setimpl(TS_AVX2) || ts_setimpl(TS_SSE2))
+        return;
+    ts_setimpl(TS_SCALAR);
+}
+
+/*
+ *  scan_scalar()
+ *  Purpose: The byte-at-a-time scanner, for machines without SIMD
+ */
+int scan_scalar(char * line, size_t len, struct tokspan * spans)
+{
+    size_t i = 0, start;
+    int n = 0;
+
+    while (i < len)
+    {
+        while (i < len && is_delim(line[i]))    /* skip leading spaces  */
+            i++;
+        if (i == len)
+            break;
+
+        start = i;                              /* find end of word     */
+        while (i < len && !is_delim(line[i]))
+            i++;
+        spans[n].ts_start = start;
+        spans[n].ts_len = i - start;
+        n++;
+    }
+    return n;
+}
+
+/*
+ *  plain_scalar()
+ *  Purpose: The byte-at-a-time ts_plain()
+ */
+size_t plain_scalar(char * str, size_t len)
+{
+    size_t i = 0;
+
+    while (i < len && !is_special(str[i]))
+        i++;
+    return i;
+}
+
+#ifdef TS_X86
+
+/*
+ *  add_edges()
+ *  Purpose: Turn the token mask of one block into spans
+ *    Input: word, one bit per byte of the block, set if it is in a token
+ *           width, bytes in the block (16 or 32)
+ *           base, offset of the block in the line
+ *           carryp, set if the byte before the block was in a token; it is
+ *                   updated for the next block
+ *           startp, start of the token that is still open, if any
+ *           spans, np, where spans go and how many there are
+ *   Method: Shifting the mask left by one lines each byte up with the one
+ *           before it. A start is a token byte after a blank, an end is a
+ *           blank after a token byte. The edges are visited lowest first.
+ */
+static inline void add_edges(uint32_t word, int width, size_t base,
+                             uint32_t * carryp, size_t * startp,
+                             struct tokspan * spans, int * np)
+{
+    uint32_t full  = (width == 32 ? 0xFFFFFFFFu : (1u << width) - 1);
+    uint32_t prev  = (word << 1) | *carryp;
+    uint32_t edges = ((word & ~prev) | (~word & prev)) & full;
+    uint32_t bit;
+
+    while (edges != 0)
+    {
+        bit = __builtin_ctz(edges);
+        if (word & (1u << bit))                     // start of a token
+            *startp = base + bit;
+        else                                        // end of a token
+        {
+            spans[*np].ts_start = *startp;
+            spans[*np].ts_len = base + bit - *startp;
+            (*np)++;
+        }
+        edges &= edges - 1;                         // next edge
+    }
+    *carryp = (word >> (width - 1)) & 1;
+}
+
+/*
+ *  scan_sse2()
+ *  Purpose: Find tokens 16 bytes at a time
+ */
+static int scan_sse2(char * line, size_t len, struct tokspan * spans)
+{
+    const __m128i blank = _mm_set1_epi8(' ');
+    const __m128i tab   = _mm_set1_epi8('\t');
+    char tail[16];
+    __m128i v;
+    uint32_t delims, carry = 0;
+    size_t pos, start = 0;
+    int n = 0;
+
+    for (pos = 0; pos < len; pos += 16)
+    {
+        if (len - pos >= 16)
+            v = _mm_loadu_si128((const __m128i *) (line + pos));
+        else                                        // pad the last block
+        {
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, line + pos, len - pos);
+            v = _mm_loadu_si128((const __m128i *) tail);
+        }
+        delims = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, blank),
+                                                _mm_cmpeq_epi8(v, tab)));
+        add_edges(~delims & 0xFFFF, 16, pos, &carry, &start, spans, &n);
+    }
+
+    if (carry)                                      // token runs to the end
+    {
+        spans[n].ts_start = start;
+        spans[n].ts_len = len - start;
+        n++;
+    }
+    return n;
+}
+
+/*
+ *  scan_avx2()
+ *  Purpose: Find tokens 32 bytes at a time
+ */
+__attribute__((target("avx2")))
+static int scan_avx2(char * line, size_t len, struct tokspan * spans)
+{
+    const __m256i blank = _mm256_set1_epi8(' ');
+    const __m256i tab   = _mm256_set1_epi8('\t');
+    char tail[32];
+    __m256i v;
+    uint32_t delims, carry = 0;
+    size_t pos, start = 0;
+    int n = 0;
+
+    for (pos = 0; pos < len; pos += 32)
+    {
+        if (len - pos >= 32)
+            v = _mm256_loadu_si256((const __m256i *) (line + pos));
+        else                                        // pad the last block
+        {
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, line + pos, len - pos);
+            v = _mm256_loadu_si256((const __m256i *) tail);
+        }
+        delims = _mm256_movemask_epi8(_mm256_or_si256(
+                                        _mm256_cmpeq_epi8(v, blank),
+                                        _mm256_cmpeq_epi8(v, tab)));
+        add_edges(~delims, 32, pos, &carry, &start, spans, &n);
+    }
+
+    if (carry)                                      // token runs to the end
+    {
+        spans[n].ts_start = start;
+        spans[n].ts_len = len - start;
+        n++;
+    }
+    return n;
+}
+
+/*
+ *  plain_sse2()
+ *  Purpose: ts_plain() 16 bytes at a time; the short tail is done by bytes
+ */
+static size_t plain_sse2(char * str, size_t len)
+{
+    const __m128i blank = _mm_set1_epi8(' ');
+    const __m128i tab   = _mm_set1_epi8('\t');
+    const __m128i dollar = _mm_set1_epi8('$');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i hash  = _mm_set1_epi8('#');
+    const __m128i bar   = _mm_set1_epi8('|');
+    const __m128i amp   = _mm_set1_epi8('&');
+    const __m128i bquote = _mm_set1_epi8('`');
+    __m128i v, hits;
+    uint32_t mask;
+    size_t pos;
+
+    for (pos = 0; pos + 16 <= len; pos += 16)
+    {
+        v = _mm_loadu_si128((const __m128i *) (str + pos));
+        hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, blank),
+                                         _mm_cmpeq_epi8(v, tab)),
+                            _mm_or_si128(_mm_cmpeq_epi8(v, dollar),
+                                         _mm_or_si128(_mm_cmpeq_epi8(v, bslash),
+                                                      _mm_cmpeq_epi8(v, hash))));
+        hits = _mm_or_si128(hits, _mm_or_si128(_mm_cmpeq_epi8(v, bar),
+                                               _mm_cmpeq_epi8(v, amp)));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(v, bquote));
+        mask = _mm_movemask_epi8(hits);
+        if (mask != 0)
+            return pos + __builtin_ctz(mask);
+    }
+    return pos + plain_scalar(str + pos, len - pos);
+}
+
+/*
+ *  plain_avx2()
+ *  Purpose: ts_plain() 32 bytes at a time; the short tail is done by bytes
+ */
+__attribute__((target("avx2")))
+static size_t plain_avx2(char * str, size_t len)
+{
+    const __m256i blank = _mm256_set1_epi8(' ');
+    const __m256i tab   = _mm256_set1_epi8('\t');
+    const __m256i dollar = _mm256_set1_epi8('$');
+    const __m256i bslash = _mm256_set1_epi8('\\');
+    const __m256i hash  = _mm256_set1_epi8('#');
+    const __m256i bar   = _mm256_set1_epi8('|');
+    const __m256i amp   = _mm256_set1_epi8('&');
+    const __m256i bquote = _mm256_set1_epi8('`');
+    __m256i v, hits;
+    uint32_t mask;
+    size_t pos;
+
+    for (pos = 0; pos + 32 <= len; pos += 32)
+    {
+        v = _mm256_loadu_si256((const __m256i *) (str + pos));
+        hits = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, blank),
+                                    _mm256_cmpeq_epi8(v, tab)),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, dollar),
+                                    _mm256_or_si256(_mm256_cmpeq_epi8(v, bslash),
+                                                    _mm256_cmpeq_epi8(v, hash))));
+        hits = _mm256_or_si256(hits,
+                               _mm256_or_si256(_mm256_cmpeq_epi8(v, bar),
+                                               _mm256_cmpeq_epi8(v, amp)));
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(v, bquote));
+        mask = _mm256_movemask_epi8(hits);
+        if (mask != 0)
+            return pos + __builtin_ctz(mask);
+    }
+    return pos + plain_scalar(str + pos, len - pos);
+}
+
+#endif
@@ -0,0 +1,27 @@
+/*
+ * ==========================
+ *   FILE: ./tokscan.h
+ * ==========================
+ * Purpose: Header file for tokscan.c
+ */
+
+#ifndef	TOKSCAN_H
+#define	TOKSCAN_H
+
+#include    <stddef.h>
+
+/* SCANNERS */
+enum ts_impls { TS_SCALAR, TS_SSE2, TS_AVX2 };
+
+/* where one token is in the line */
+struct tokspan {
+    size_t  ts_start;
+    size_t  ts_len;
+};
+
+int ts_split(char *line, size_t len, struct tokspan **spansp, size_t *nslotsp);
+size_t ts_plain(char *str, size_t len);
+int ts_setimpl(int impl);
+char * ts_implname();
+
+#endif
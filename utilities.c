@@ -0,0 +1,665 @@
+/*
+ * ==========================
+ *   FILE: ./utilities.c
+ * ==========================
+ * Purpose: Built-in versions of echo, test and [, true, false and printf.
+ *
+ * Outline: These are small programs in /bin, but scripts use them all the
+ * time -- every "if test ..." runs one -- and starting a process for each
+ * costs far more than what they do. Run in the shell, they cost a function
+ * call. They behave like the programs they replace:
+ *      echo [-neE] args    -- as /bin/echo: -n no newline, -e escapes
+ *      test expr, [ expr ] -- the POSIX rules for 0 to 4 args, and -a, -o,
+ *                             '!' and parentheses beyond that
+ *      true, false         -- status 0 and 1
+ *      printf fmt args     -- the format is used again while args are left
+ * Their output goes to stdout, through its buffer like the other builtins'.
+ * It is flushed before anything is started (see start_command()), so it
+ * comes out before what a later program prints, and before any error
+ * message (see complain() in smsh.c). Error messages follow 'dash'; a bad
+ * expression or number gives status 2 (test) or 1 (printf).
+ *
+ * interface:
+ *      is_echo(), is_test(), is_true(), is_false(), is_printf()
+ *          -- as the other is_ functions in builtin.c: is_builtin() finds
+ *             them by name in cmdtable.c, runs them and gets the status
+ */
+
+/* INCLUDES */
+#include    <stdio.h>
+#include    <stdlib.h>
+#include    <string.h>
+#include    <errno.h>
+#include    <unistd.h>
+#include    <sys/stat.h>
+#include    "smsh.h"
+#include    "utilities.h"
+
+/* CONSTANTS */
+#define T_TRUE      0               // test results are exit statuses
+#define T_FALSE     1
+#define T_ERROR     2
+#define STOP        (-1)            // put_escape() saw "\c"
+
+/* FILE-SCOPE VARIABLES */
+static char ** targs;               // test: the expression being read
+static int tpos, tend;              //  where it is, where it ends
+static int terr;                    //  an error was reported
+
+/* INTERNAL FUNCTIONS */
+static int test_args(int, int);
+static int t_or();
+static int t_and();
+static int t_not();
+static int t_primary();
+static int is_unop(char *);
+static int is_binop(char *);
+static int unary(char *, char *);
+static int binary(char *, char *, char *);
+static long long t_number(char *);
+static int t_error(char *, char *);
+static int do_format(char *, char ***);
+static int put_escape(char **, int);
+static long long num_arg(char ***, int *);
+static double float_arg(char ***, int *);
+static char * str_arg(char ***);
+
+/*
+ *  is_echo()
+ *  Purpose: The 'echo' builtin, as /bin/echo: print the args with a blank
+ *           between them and a newline at the end
+ *   Return: 1 (it is a built-in function). resultp is 0.
+ *     Note: Leading args made only of the letters n, e and E are options:
+ *           -n leaves out the newline, -e turns on backslash escapes (as
+ *           for printf's %b) and -E turns them off again.
+ */
+int is_echo(char **args, int *resultp)
+{
+    int newline = 1, escapes = 0;
+    char *cp;
+
+    for (args++; *args != NULL && (*args)[0] == '-' && (*args)[1]; args++)
+    {
+        if ( strspn(*args + 1, "neE") != strlen(*args + 1) )
+            break;                          // not an option: print it
+        for (cp = *args + 1; *cp; cp++)
+            if (*cp == 'n')
+                newline = 0;
+            else
+                escapes = (*cp == 'e');
+    }
+
+    for ( ; *args != NULL; args++)
+    {
+        for (cp = *args; *cp; )
+            if ( escapes && *cp == '\\' )
+            {
+                if ( put_escape(&cp, 1) == STOP )
+                    goto done;              // "\c": nothing more at all
+            }
+            else
+                putchar(*cp++);
+        if ( args[1] != NULL )
+            putchar(' ');
+    }
+    if ( newline )
+        putchar('\n');
+done:
+    *resultp = 0;
+    return 1;
+}
+
+/*
+ *  is_true(), is_false()
+ *  Purpose: The 'true' and 'false' builtins; the args are ignored
+ */
+int is_true(char **args, int *resultp)
+{
+    *resultp = 0;
+    return 1;
+}
+
+int is_false(char **args, int *resultp)
+{
+    *resultp = 1;
+    return 1;
+}
+
+/*
+ *  is_test()
+ *  Purpose: The 'test' and '[' builtins: evaluate an expression
+ *   Return: 1 (it is a built-in function). resultp is 0 if the
+ *           expression is true, 1 if it is false, 2 if it is bad.
+ */
+int is_test(char **args, int *resultp)
+{
+    int n;
+
+    for (n = 0; args[n] != NULL; n++)
+        ;
+    if ( args[0][0] == '[' )
+    {
+        if ( strcmp(args[n - 1], "]") != 0 )
+        {
+            complain("[: missing ]\n");
+            *resultp = T_ERROR;
+            return 1;
+        }
+        n--;                                // the ']' is not part of it
+    }
+
+    targs = args;
+    terr = 0;
+    *resultp = test_args(1, n);
+    if ( terr )
+        *resultp = T_ERROR;
+    return 1;
+}
+
+/*
+ *  test_args()
+ *  Purpose: Evaluate targs[start] to targs[end - 1]
+ *   Method: POSIX says what 0 to 4 args mean by how many there are, so
+ *           "test -n" or "test ! = x" work; beyond that, the expression
+ *           is parsed (t_or() and below).
+ */
+int test_args(int start, int end)
+{
+    char **av = targs + start;
+    int n = end - start, rv;
+
+    if (n == 0)
+        return T_FALSE;
+    if (n == 1)
+        return av[0][0] != '\0' ? T_TRUE : T_FALSE;
+    if (n == 2 && strcmp(av[0], "!") == 0)
+        return av[1][0] != '\0' ? T_FALSE : T_TRUE;
+    if (n == 2 && is_unop(av[0]))
+        return unary(av[0], av[1]);
+    if (n == 3 && is_binop(av[1]))
+        return binary(av[0], av[1], av[2]);
+    if ((n == 3 || n == 4) && strcmp(av[0], "!") == 0)
+        return (rv = test_args(start + 1, end)) == T_ERROR ? rv : !rv;
+    if ((n == 3 || n == 4) && strcmp(av[0], "(") == 0 &&
+        strcmp(av[n - 1], ")") == 0)
+        return test_args(start + 1, end - 1);
+    if (n == 2)
+        return t_error(av[1], "unexpected operator");
+
+    tpos = start;
+    tend = end;
+    rv = t_or();
+    if (tpos < tend && !terr)
+        t_error(targs[tpos], "unexpected operator");
+    return rv;
+}
+
+/*
+ *  t_or(), t_and(), t_not(), t_primary()
+ *  Purpose: Parse and evaluate a longer test expression:
+ *               or      := and [ -o and ]...
+ *               and     := not [ -a not ]...
+ *               not     := ! not | primary
+ *               primary := ( or ) | arg binop arg | unop arg | arg
+ *   Return: T_TRUE or T_FALSE (terr is set on an error)
+ */
+int t_or()
+{
+    int rv = t_and();
+
+    while (tpos < tend && strcmp(targs[tpos], "-o") == 0)
+    {
+        tpos++;
+        if (t_and() == T_TRUE)
+            rv = T_TRUE;
+    }
+    return rv;
+}
+
+int t_and()
+{
+    int rv = t_not();
+
+    while (tpos < tend && strcmp(targs[tpos], "-a") == 0)
+    {
+        tpos++;
+        if (t_not() == T_FALSE)
+            rv = T_FALSE;
+    }
+    return rv;
+}
+
+int t_not()
+{
+    if (tpos < tend && strcmp(targs[tpos], "!") == 0)
+    {
+        tpos++;
+        return t_not() == T_TRUE ? T_FALSE : T_TRUE;
+    }
+    return t_primary();
+}
+
+int t_primary()
+{
+    char **av = targs + tpos;
+    int rv;
+
+    if (tpos >= tend)
+        return t_error(targs[tpos - 1], "argument expected");
+
+    if (strcmp(av[0], "(") == 0)
+    {
+        tpos++;
+        rv = t_or();
+        if (tpos >= tend || strcmp(targs[tpos], ")") != 0)
+            return t_error("(", "missing )");
+        tpos++;
+        return rv;
+    }
+    if (tpos + 1 < tend && is_binop(av[1]))
+    {
+        if (tpos + 2 >= tend)
+            return t_error(av[1], "argument expected");
+        tpos += 3;
+        return binary(av[0], av[1], av[2]);
+    }
+    if (is_unop(av[0]) && tpos + 1 < tend)
+    {
+        tpos += 2;
+        return unary(av[0], av[1]);
+    }
+    tpos++;
+    return av[0][0] != '\0' ? T_TRUE : T_FALSE;
+}
+
+/*
+ *  is_unop(), is_binop()
+ *  Purpose: Tell whether a word is a unary or a binary test operator
+ */
+int is_unop(char * s)
+{
+    return s[0] == '-' && s[1] != '\0' && s[2] == '\0' &&
+           strchr("bcdefghLknprsStuwxz", s[1]) != NULL;
+}
+
+int is_binop(char * s)
+{
+    static char *ops[] = { "=", "!=", "==", "<", ">", "-eq", "-ne", "-lt",
+                           "-le", "-gt", "-ge", "-nt", "-ot", "-ef", NULL };
+    int i;
+
+    for (i = 0; ops[i] != NULL; i++)
+        if (strcmp(s, ops[i]) == 0)
+            return 1;
+    return 0;
+}
+
+/*
+ *  unary()
+ *  Purpose: Apply a unary test operator
+ *   Return: T_TRUE or T_FALSE
+ */
+int unary(char * op, char * arg)
+{
+    struct stat info;
+    int ok;
+
+    switch (op[1])
+    {
+    case 'n':   return arg[0] != '\0' ? T_TRUE : T_FALSE;
+    case 'z':   return arg[0] == '\0' ? T_TRUE : T_FALSE;
+    case 't':   return isatty(t_number(arg)) ? T_TRUE : T_FALSE;
+    case 'r':   return access(arg, R_OK) == 0 ? T_TRUE : T_FALSE;
+    case 'w':   return access(arg, W_OK) == 0 ? T_TRUE : T_FALSE;
+    case 'x':   return access(arg, X_OK) == 0 ? T_TRUE : T_FALSE;
+    case 'h':
+    case 'L':   return lstat(arg, &info) == 0 && S_ISLNK(info.st_mode)
+                       ? T_TRUE : T_FALSE;
+    }
+
+    if (stat(arg, &info) == -1)
+        return T_FALSE;
+
+    switch (op[1])
+    {
+    case 'b':   ok = S_ISBLK(info.st_mode);             break;
+    case 'c':   ok = S_ISCHR(info.st_mode);             break;
+    case 'd':   ok = S_ISDIR(info.st_mode);             break;
+    case 'f':   ok = S_ISREG(info.st_mode);             break;
+    case 'p':   ok = S_ISFIFO(info.st_mode);            break;
+    case 'S':   ok = S_ISSOCK(info.st_mode);            break;
+    case 'g':   ok = (info.st_mode & S_ISGID) != 0;     break;
+    case 'u':   ok = (info.st_mode & S_ISUID) != 0;     break;
+    case 'k':   ok = (info.st_mode & S_ISVTX) != 0;     break;
+    case 's':   ok = info.st_size > 0;                  break;
+    default:    ok = 1;                                 break;  // -e
+    }
+    return ok ? T_TRUE : T_FALSE;
+}
+
+/*
+ *  binary()
+ *  Purpose: Apply a binary test operator
+ *   Return: T_TRUE or T_FALSE (terr is set if a number is bad)
+ */
+int binary(char * a, char * op, char * b)
+{
+    struct stat sa, sb;
+    long long x, y;
+    int ok, cmp;
+
+    if (op[0] != '-')                       // strings
+    {
+        cmp = strcmp(a, b);
+        if (op[0] == '<')
+            ok = cmp < 0;
+        else if (op[0] == '>')
+            ok = cmp > 0;
+        else
+            ok = (op[0] == '!' ? cmp != 0 : cmp == 0);
+        return ok ? T_TRUE : T_FALSE;
+    }
+
+    if (op[1] == 'n' && op[2] == 't')       // files: newer, older, same
+        ok = stat(a, &sa) == 0 && (stat(b, &sb) == -1 ||
+             sa.st_mtime > sb.st_mtime);
+    else if (op[1] == 'o' && op[2] == 't')
+        ok = stat(b, &sb) == 0 && (stat(a, &sa) == -1 ||
+             sa.st_mtime < sb.st_mtime);
+    else if (op[1] == 'e' && op[2] == 'f')
+        ok = stat(a, &sa) == 0 && stat(b, &sb) == 0 &&
+             sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+    else                                    // integers
+    {
+        x = t_number(a);
+        y = t_number(b);
+        if (op[1] == 'e')
+            ok = x == y;
+        else if (op[1] == 'n')
+            ok = x != y;
+        else if (op[1] == 'l')
+            ok = (op[2] == 't' ? x < y : x <= y);
+        else
+            ok = (op[2] == 't' ? x > y : x >= y);
+    }
+    return ok ? T_TRUE : T_FALSE;
+}
+
+/*
+ *  t_number()
+ *  Purpose: Read an integer for test, blanks around it allowed
+ *   Return: its value (0 and terr set if it is not a number)
+ */
+long long t_number(char * s)
+{
+    char *end;
+    long long val;
+
+    errno = 0;
+    val = strtoll(s, &end, 10);
+    while (*end == ' ' || *end == '\t')
+        end++;
+    if (end == s || *end != '\0' || errno == ERANGE)
+    {
+        t_error(s, "Illegal number");
+        return 0;
+    }
+    return val;
+}
+
+/*
+ *  t_error()
+ *  Purpose: Report a bad test expression, once
+ *   Return: T_ERROR
+ */
+int t_error(char * what, char * msg)
+{
+    if (!terr)
+    {
+        if (strcmp(msg, "Illegal number") == 0)
+            complain("test: %s: %s\n", msg, what);
+        else
+            complain("test: %s: %s\n", what, msg);
+    }
+    terr = 1;
+    return T_ERROR;
+}
+
+/*
+ *  is_printf()
+ *  Purpose: The 'printf' builtin: print the args as the format says
+ *   Return: 1 (it is a built-in function). resultp is 0 if ok, 1 if
+ *           an arg was not a good number, 2 with no format.
+ *     Note: If args are left when the format runs out, it is used again,
+ *           as long as it used some of them.
+ */
+int is_printf(char **args, int *resultp)
+{
+    char **av, **before;
+    int rv = 0;
+
+    if ( args[1] == NULL )
+    {
+        complain("printf: usage: printf format [arg ...]\n");
+        *resultp = 2;
+        return 1;
+    }
+
+    av = args + 2;
+    do
+    {
+        before = av;
+        rv = do_format(args[1], &av);
+    }
+    while ( rv != STOP && *av != NULL && av != before );
+
+    *resultp = (rv == STOP ? 0 : rv);
+    return 1;
+}
+
+/*
+ *  do_format()
+ *  Purpose: Go through the format once, taking args from *avp as needed
+ *   Return: 0 if ok, 1 if a number was bad, STOP if "\c" ended the output
+ *   Method: Each conversion is copied into spec with its flags, width and
+ *           precision, then handed to printf() with the arg converted to
+ *           the type it wants ('*' widths are taken from the args too).
+ */
+int do_format(char * fmt, char *** avp)
+{
+    char spec[64], *cp = fmt, *start, *s;
+    int rv = 0, nstar, star[2], len;
+    long long ival;
+    double fval;
+
+    while (*cp)
+    {
+        if (*cp == '\\')
+        {
+            if (put_escape(&cp, 0) == STOP)
+                return STOP;
+            continue;
+        }
+        if (*cp != '%')
+        {
+            putchar(*cp++);
+            continue;
+        }
+        if (cp[1] == '%')
+        {
+            putchar('%');
+            cp += 2;
+            continue;
+        }
+
+        start = cp++;                       // %[flags][width][.prec]conv
+        nstar = 0;
+        cp += strspn(cp, "-+ #0");
+        if (*cp == '*' && cp++)
+            star[nstar++] = (int) num_arg(avp, &rv);
+        else
+            cp += strspn(cp, "0123456789");
+        if (*cp == '.')
+        {
+            cp++;
+            if (*cp == '*' && cp++)
+                star[nstar++] = (int) num_arg(avp, &rv);
+            else
+                cp += strspn(cp, "0123456789");
+        }
+
+        len = cp - start;
+        if (*cp == '\0' || len + 4 > (int) sizeof(spec))
+        {
+            complain("printf: %s: invalid directive\n", start);
+            return 1;
+        }
+        memcpy(spec, start, len);
+
+        switch (*cp)
+        {
+        case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+            strcpy(spec + len, "ll");       // take them all as long long
+            spec[len + 2] = *cp;
+            spec[len + 3] = '\0';
+            ival = num_arg(avp, &rv);
+            if (nstar == 2)
+                printf(spec, star[0], star[1], ival);
+            else if (nstar == 1)
+                printf(spec, star[0], ival);
+            else
+                printf(spec, ival);
+            break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G':
+        case 'a': case 'A':
+            spec[len] = *cp;
+            spec[len + 1] = '\0';
+            fval = float_arg(avp, &rv);
+            if (nstar == 2)
+                printf(spec, star[0], star[1], fval);
+            else if (nstar == 1)
+                printf(spec, star[0], fval);
+            else
+                printf(spec, fval);
+            break;
+        case 'c':
+            s = str_arg(avp);
+            if (*s)
+                putchar(*s);
+            break;
+        case 's':
+        case 'b':
+            spec[len] = 's';
+            spec[len + 1] = '\0';
+            s = str_arg(avp);
+            if (*cp == 'b')                 // escapes in the arg: no width
+            {
+                while (*s)
+                    if (*s != '\\')
+                        putchar(*s++);
+                    else if (put_escape(&s, 1) == STOP)
+                        return STOP;
+            }
+            else if (nstar == 2)
+                printf(spec, star[0], star[1], s);
+            else if (nstar == 1)
+                printf(spec, star[0], s);
+            else
+                printf(spec, s);
+            break;
+        default:
+            complain("printf: %%%c: invalid directive\n", *cp);
+            return 1;
+        }
+        cp++;
+    }
+    return rv;
+}
+
+/*
+ *  put_escape()
+ *  Purpose: Print the char a backslash escape stands for
+ *    Input: sp, points at the '\'; moved past the escape
+ *           barg, 1 for echo and %b (octal is \0NNN), 0 for the format
+ *                 (octal is \NNN)
+ *   Return: 0, or STOP for "\c" (print nothing more)
+ */
+int put_escape(char ** sp, int barg)
+{
+    static char from[] = "\\abfnrtv\"'";
+    static char to[]   = "\\\a\b\f\n\r\t\v\"'";
+    char *cp = *sp + 1, *hit;
+    int val = 0, n;
+
+    if (*cp == 'c')
+        return STOP;
+
+    if (*cp >= '0' && *cp <= '7')           // octal, up to 3 digits
+    {
+        if (barg && *cp == '0')
+            cp++;
+        for (n = 0; n < 3 && *cp >= '0' && *cp <= '7'; n++)
+            val = val * 8 + *cp++ - '0';
+        putchar(val);
+    }
+    else if (*cp != '\0' && (hit = strchr(from, *cp)) != NULL)
+    {
+        putchar(to[hit - from]);
+        cp++;
+    }
+    else                                    // not an escape: keep the '\'
+        putchar('\\');
+
+    *sp = cp;
+    return 0;
+}
+
+/*
+ *  num_arg(), float_arg(), str_arg()
+ *  Purpose: Take the next printf arg as an integer, a double or a string
+ *   Return: its value; 0 or "" if the args have run out
+ *     Note: A number that starts with ' or " is the code of the char
+ *           after it. A bad number is reported, and *badp set to 1.
+ */
+long long num_arg(char *** avp, int * badp)
+{
+    char *s = str_arg(avp), *end;
+    long long val;
+
+    if (*s == '\'' || *s == '"')
+        return (unsigned char) s[1];
+
+    errno = 0;
+    val = (*s == '-' ? strtoll(s, &end, 0) : (long long) strtoull(s, &end, 0));
+    if (*s != '\0' && (end == s || *end != '\0' || errno == ERANGE))
+    {
+        complain("printf: %s: expected numeric value\n", s);
+        *badp = 1;
+    }
+    return val;
+}
+
+double float_arg(char *** avp, int * badp)
+{
+    char *s = str_arg(avp), *end;
+    double val;
+
+    if (*s == '\'' || *s == '"')
+        return (unsigned char) s[1];
+
+    val = strtod(s, &end);
+    if (*s != '\0' && (end == s || *end != '\0'))
+    {
+        complain("printf: %s: expected numeric value\n", s);
+        *badp = 1;
+    }
+    return val;
+}
+
+char * str_arg(char *** avp)
+{
+    if (**avp == NULL)
+        return "";
+    return *(*avp)++;
+}
+
@@ -0,0 +1,17 @@
+/*
+ * ==========================
+ *   FILE: ./utilities.h
+ * ==========================
+ * Purpose: Header file for utilities.c
+ */
+
+#ifndef	UTILITIES_H
+#define	UTILITIES_H
+
+int is_echo(char **args, int *resultp);
+int is_test(char **args, int *resultp);
+int is_true(char **args, int *resultp);
+int is_false(char **args, int *resultp);
+int is_printf(char **args, int *resultp);
+
+#endif
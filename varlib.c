@@ -6,19 +6,41 @@
  * interface:
  *     VLstore( name, value )    returns 0 for 0k, 1 for no
  *     VLlookup( name )          returns string or NULL if not there
+ *     VLlookupn( name, len )    same, for a name that is not '\0'-term.
  *     VLlist()			 prints out current table
  *
  * environment-related functions
  *     VLexport( name )		 adds name to list of env vars
  *     VLtable2environ()	 copy from table to environ
+ *     VLenviron()		 same, but cached: do not change or free it
  *     VLenviron2table()         copy from environ to table
  *
  * details:
- *	the table is stored as an array of structs that
- *	contain a flag for `global' and a single string of
- *	the form name=value.  This allows EZ addition to the
- *	environment.  It makes searching pretty easy, as
- *	long as you search for "name=" 
+ *	each variable is a struct with a flag for `global' and a
+ *	single string of the form name=value.  This allows EZ
+ *	addition to the environment.  The struct also keeps the
+ *	length of the name, so the value is at str + nlen + 1, and
+ *	the size of the buffer str is in.  A new value that fits is
+ *	copied over the old one, so reassigning a var (a loop var,
+ *	a counter) does not call malloc() once the buffer is big
+ *	enough, and the name=value form is always ready to export
+ *	without being built.  The structs are kept in one
+ *	array, in the order the variables were first stored, which
+ *	is the order `set' lists them and the environment gets them.
+ *	Both the array and the index grow as needed (there used to
+ *	be a limit of 200 vars, which a big environment went over).
+ *
+ *	To find a name, the table is indexed by an open-addressing
+ *	hash table (linear probing) of positions in the array.  Each
+ *	struct keeps the hash and length of its name, so most misses
+ *	are rejected without looking at the string.  There is no
+ *	delete, so the index needs no tombstones.
+ *
+ *	The array of exported strings handed to each new program is
+ *	kept between calls by VLenviron().  env_gen counts changes to
+ *	exported vars; the array is rebuilt only when it has moved on
+ *	since the last build, so a script that runs thousands of
+ *	commands without touching the environment builds it once.
  *
  * hist: 2015-05-14 VLstore now handles NULL cases safely (10q mk)
  */
@@ -26,19 +48,33 @@
 #include	<stdio.h>
 #include	<stdlib.h>
 #include	"varlib.h"
+#include	"pathcache.h"
 #include	<string.h>
 
-#define	MAXVARS	200		/* a linked list would be nicer */
+#define	MINVARS	64		/* first size of the table	*/
 
 struct var {
-		char *str;		/* name=val string	*/
-		int  global;		/* a boolean		*/
+		char	*str;		/* name=val string	*/
+		size_t	nlen;		/* length of name	*/
+		size_t	room;		/* size of str's buffer	*/
+		unsigned hash;		/* hash of name		*/
+		int	global;		/* a boolean		*/
 	};
 
-static struct var tab[MAXVARS];			/* the table	*/
+static struct var *tab = NULL;			/* the table	*/
+static int	nvars = 0;			/* vars in tab	*/
+static int	maxvars = 0;			/* room in tab	*/
+static int	*slots = NULL;			/* 1 + position in tab, 0=free */
+static unsigned	nslots = 0;			/* slots, a power of 2	*/
+static char	**envcache = NULL;		/* built by VLenviron()	*/
+static int	envroom = 0;			/* room in envcache	*/
+static unsigned	env_gen = 1;			/* bumped by changes	*/
+static unsigned	envcache_gen = 0;		/* env_gen when built	*/
 
-static char *new_string( char *, char *);	/* private methods	*/
-static struct var *find_item(char *, int);
+static struct var *find_item(char *, size_t);	/* private methods	*/
+static struct var *add_item(char *, size_t, size_t);
+static int grow_index();
+static unsigned hash_name(char *, size_t);
 
 void VLinit()
 /*
@@ -49,56 +85,73 @@ void VLinit()
 
 int VLstore( char *name, char *val )
 /*
- * traverse list, if found, replace it, else add at end
- * since there is no delete, a blank one is a free one
+ * find the var, if found, replace its value, else add at end
  * return 1 if trouble, 0 if ok (like a command)
+ * note: the value goes over the old one when it fits; if not, the
+ *	 buffer is grown with some room to spare, so it soon stops
+ *	 having to grow
  */
 {
 	struct var *itemp;
+	size_t	nlen, vlen, need, room;
 	char	*s;
-	int	rv = 1;				/* assume failure	*/
 
-	/* find spot to put it              and make new string */
-	if ((itemp=find_item(name,1))!=NULL && (s=new_string(name,val))!=NULL) 
-	{
-		if ( itemp->str )		/* has a val?	*/
-			free(itemp->str);	/* y: remove it	*/
-		itemp->str = s;
-		rv = 0;				/* ok! */
+	if ( name == NULL )
+		return 1;
+	if ( val == NULL )
+		val = "";
+
+	nlen = strlen(name);
+	vlen = strlen(val);
+	if ( nlen == 4 && memcmp(name, "PATH", 4) == 0 )
+		pc_clear();			/* commands may move	*/
+	need = nlen + 1 + vlen + 1;			/* name=val\0	*/
+	itemp = find_item(name, nlen);
+
+	if ( itemp != NULL && need <= itemp->room ){	/* fits: no malloc */
+		memmove(itemp->str + nlen + 1, val, vlen + 1);
+		return 0;
 	}
-	return rv;
+
+	room = need + need / 2;
+	if ( (s = realloc(itemp ? itemp->str : NULL, room)) == NULL )
+		return 1;
+	if ( itemp == NULL ){				/* a new var	*/
+		memcpy(s, name, nlen);
+		if ( (itemp = add_item(s, nlen, room)) == NULL ){
+			free(s);
+			return 1;
+		}
+		s[nlen] = '=';
+	}
+	else if ( s != itemp->str && itemp->global )	/* envcache had	*/
+		env_gen++;				/* the old str	*/
+	memcpy(s + nlen + 1, val, vlen + 1);
+	itemp->str = s;
+	itemp->room = room;
+	return 0;				/* ok! */
 }
 
-char * new_string( char *name, char *val )
+char * VLlookup( char *name )
 /*
- * returns new string of form name=value or NULL on error
+ * returns value of var or empty string if not there
  */
 {
-	char	*retval;
-
-	if ( name == NULL )
-		retval = NULL;
-	else if ( val == NULL )
-		retval = malloc(strlen(name)+1);
-	else
-		retval = malloc( strlen(name) + strlen(val) + 2 );
-
-	if ( retval != NULL )
-		sprintf(retval, "%s=%s", name, (val==NULL ? "" : val) );
-	return retval;
+	return VLlookupn(name, strlen(name));
 }
 
-char * VLlookup( char *name )
+char * VLlookupn( char *name, size_t len )
 /*
- * returns value of var or empty string if not there
+ * returns value of the var named by the len chars at name,
+ * or empty string if not there (lets the lexer look up a
+ * name without copying it out of the command line)
  */
 {
 	struct var *itemp;
 
-	if ( (itemp = find_item(name,0)) != NULL )
-		return itemp->str + 1 + strlen(name);
+	if ( (itemp = find_item(name,len)) != NULL )
+		return itemp->str + 1 + len;
 	return "";
-
 }
 
 int VLexport( char *name )
@@ -110,7 +163,9 @@ int VLexport( char *name )
 	struct var *itemp;
 	int	rv = 1;
 
-	if ( (itemp = find_item(name,0)) != NULL ){
+	if ( (itemp = find_item(name,strlen(name))) != NULL ){
+		if ( !itemp->global )
+			env_gen++;
 		itemp->global = 1;
 		rv = 0;
 	}
@@ -119,34 +174,103 @@ int VLexport( char *name )
 	return rv;
 }
 
-static struct var * find_item( char *name , int first_blank )
+static struct var * find_item( char *name , size_t len )
 /*
- * searches table for an item
+ * searches table for an item (name is len chars long)
  * returns ptr to struct or NULL if not found
- * OR if (first_blank) then ptr to first blank one
  */
 {
-	int	i;
-	int	len ;
-	char	*s;
+	unsigned h, mask, i;
+	int	pos;
+	struct var *vp;
 
-	if ( name == NULL )
+	if ( name == NULL || nslots == 0 )
 		return NULL;
 
-	len = strlen(name);
-
-	for( i = 0 ; i<MAXVARS && tab[i].str != NULL ; i++ )
-	{
-		s = tab[i].str;
-		if ( strncmp(s,name,len) == 0 && s[len] == '=' ){
-			return &tab[i];
-		}
+	h = hash_name(name, len);
+	mask = nslots - 1;
+	for ( i = h & mask ; (pos = slots[i]) != 0 ; i = (i+1) & mask ){
+		vp = &tab[pos-1];
+		if ( vp->hash == h && vp->nlen == len
+		     && memcmp(vp->str, name, len) == 0 )
+			return vp;
 	}
-	if ( i < MAXVARS && first_blank )
-		return &tab[i];
 	return NULL;
 }
 
+static struct var * add_item( char *str, size_t nlen, size_t room )
+/*
+ * append a var for str (a buffer of room chars that starts with a
+ * name nlen long) to the table and put it in the index
+ * returns ptr to it, or NULL if out of memory
+ */
+{
+	struct var *vp;
+	unsigned mask, i;
+
+	if ( nvars == maxvars ){			/* table full	*/
+		int	n = ( maxvars == 0 ? MINVARS : 2 * maxvars );
+		vp = realloc(tab, n * sizeof(struct var));
+		if ( vp == NULL )
+			return NULL;
+		tab = vp;
+		maxvars = n;
+	}
+	if ( 2 * (unsigned) (nvars + 1) > nslots && grow_index() != 0 )
+		return NULL;				/* keep it half empty */
+
+	vp = &tab[nvars++];
+	vp->str = str;
+	vp->nlen = nlen;
+	vp->room = room;
+	vp->hash = hash_name(str, nlen);
+	vp->global = 0;
+
+	mask = nslots - 1;
+	for ( i = vp->hash & mask ; slots[i] != 0 ; i = (i+1) & mask )
+		;
+	slots[i] = nvars;				/* 1 + position	*/
+	return vp;
+}
+
+static int grow_index()
+/*
+ * double the index (it starts at 2*MINVARS) and put every var back in
+ * returns 0 if ok, 1 if out of memory
+ */
+{
+	unsigned n = ( nslots == 0 ? 2 * MINVARS : 2 * nslots );
+	int	*newidx = calloc(n, sizeof(int));
+	unsigned i;
+	int	v;
+
+	if ( newidx == NULL )
+		return 1;
+	for ( v = 0 ; v < nvars ; v++ ){
+		for ( i = tab[v].hash & (n-1) ; newidx[i] != 0 ; i = (i+1) & (n-1) )
+			;
+		newidx[i] = v + 1;
+	}
+	free(slots);
+	slots = newidx;
+	nslots = n;
+	return 0;
+}
+
+static unsigned hash_name( char *name, size_t len )
+/*
+ * FNV-1a hash of the len chars of name
+ */
+{
+	unsigned h = 2166136261u;
+
+	while ( len-- > 0 ){
+		h ^= (unsigned char) *name++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
 
 void VLlist()
 /*
@@ -156,7 +280,7 @@ void VLlist()
  */
 {
 	int	i;
-	for(i = 0 ; i<MAXVARS && tab[i].str != NULL ; i++ )
+	for(i = 0 ; i < nvars ; i++ )
 	{
 		if ( tab[i].global )
 			printf("  * %s\n", tab[i].str);
@@ -169,26 +293,30 @@ int VLenviron2table(char *env[])
 /*
  * initialize the variable table by loading array of strings
  * return 1 for ok, 0 for not ok
+ * note: a string with no '=' is not a variable and is skipped;
+ *	 if a name is there twice, the first one is kept
  */
 {
 	int     i;
-	char	*newstring;
+	char	*eq, *newstring;
+	struct var *itemp;
 
 	for(i = 0 ; env[i] != NULL ; i++ )
 	{
-		if ( i == MAXVARS )
+		if ( (eq = strchr(env[i], '=')) == NULL )
+			continue;
+		if ( find_item(env[i], eq - env[i]) != NULL )
+			continue;		/* a repeat	*/
+		if ( (newstring = strdup(env[i])) == NULL )
 			return 0;
-		newstring = malloc(1+strlen(env[i]));
-		if ( newstring == NULL )
+		itemp = add_item(newstring, eq - env[i], strlen(newstring)+1);
+		if ( itemp == NULL ){
+			free(newstring);
 			return 0;
-		strcpy(newstring, env[i]);
-		tab[i].str = newstring;
-		tab[i].global = 1;
-	}
-	while( i < MAXVARS ){		/* I know we don't need this	*/
-		tab[i].str = NULL ;	/* static globals are nulled	*/
-		tab[i++].global = 0;	/* by default			*/
+		}
+		itemp->global = 1;
 	}
+	env_gen++;
 	return 1;
 }
 
@@ -207,7 +335,7 @@ char ** VLtable2environ()
 	 * first, count the number of global variables
 	 */
 
-	for( i = 0 ; i<MAXVARS && tab[i].str != NULL ; i++ )
+	for( i = 0 ; i < nvars ; i++ )
 		if ( tab[i].global == 1 )
 			n++;
 
@@ -217,9 +345,44 @@ char ** VLtable2environ()
 		return NULL;
 
 	/* then, load the array with pointers		*/
-	for(i = 0, j = 0 ; i<MAXVARS && tab[i].str != NULL ; i++ )
+	for(i = 0, j = 0 ; i < nvars ; i++ )
 		if ( tab[i].global == 1 )
 			envtab[j++] = tab[i].str;
 	envtab[j] = NULL;
 	return envtab;
-}
\ No newline at end of file
+}
+char ** VLenviron()
+/*
+ * like VLtable2environ(), but the array is kept and reused: it is only
+ * rebuilt when an exported var has changed since the last call.
+ * returns the array (owned here: do not free or change it), or NULL if
+ * out of memory
+ * note: call it before fork(), so the child does no work and does not
+ *	 touch (and so copy) the parent's pages to build it
+ */
+{
+	int	i, n = 0;
+	char	**newtab;
+
+	if ( envcache_gen == env_gen && envcache != NULL )
+		return envcache;
+
+	for( i = 0 ; i < nvars ; i++ )
+		if ( tab[i].global == 1 )
+			n++;
+
+	if ( n + 1 > envroom ){
+		newtab = realloc(envcache, (n+1) * sizeof(char *));
+		if ( newtab == NULL )
+			return NULL;
+		envcache = newtab;
+		envroom = n + 1;
+	}
+
+	for( i = 0, n = 0 ; i < nvars ; i++ )
+		if ( tab[i].global == 1 )
+			envcache[n++] = tab[i].str;
+	envcache[n] = NULL;
+	envcache_gen = env_gen;
+	return envcache;
+}
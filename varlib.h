@@ -1,14 +1,18 @@
 #ifndef	VARLIB_H
 #define	VARLIB_H
+
+#include	<stddef.h>
 /*
  * header for varlib.c package
  */
 
 int	VLexport(char *);
 char	*VLlookup(char *);
+char	*VLlookupn(char *, size_t);
 void	VLlist();
 int	VLstore( char *, char * );
 char	**VLtable2environ();
+char	**VLenviron();
 int	VLenviron2table(char **);
 
 #endif
\ No newline at end of file